@@ -0,0 +1,61 @@
+#include "bitrate_controller.h"
+
+#include <algorithm>
+
+BitrateController::BitrateController(const BitrateControllerConfig &config_,
+                                     int64_t initial_target,
+                                     double frame_rate) noexcept
+    : config{config_}, frame_duration{frame_rate > 0 ? 1 / frame_rate : 0},
+      target{std::clamp(initial_target, config.min_bitrate,
+                        config.max_bitrate)} {
+  config.window_frames = std::max<uint32_t>(config.window_frames, 1);
+}
+
+std::optional<int64_t>
+BitrateController::observe(uint64_t input_full_total,
+                           uint64_t bytes_total) noexcept {
+  if (frames == 0) {
+    // The totals are only known from the first observation on.
+    frames = 1;
+    input_full_start = input_full_total;
+    bytes_start = bytes_total;
+    return std::nullopt;
+  }
+  if (++frames <= config.window_frames) {
+    return std::nullopt;
+  }
+
+  const auto window{config.window_frames};
+  const auto input_full{input_full_total - input_full_start};
+  const auto bits{static_cast<double>(bytes_total - bytes_start) * 8};
+  const auto expected_bits{static_cast<double>(target) * frame_duration *
+                           window};
+  const bool congested{
+      static_cast<double>(input_full) >
+          config.input_full_threshold * window ||
+      (expected_bits > 0 && bits > expected_bits * config.overshoot_threshold)};
+
+  // The observation that closes this window opens the next one.
+  frames = 1;
+  input_full_start = input_full_total;
+  bytes_start = bytes_total;
+
+  const auto previous{target};
+  if (congested) {
+    target = static_cast<int64_t>(static_cast<double>(target) *
+                                  config.decrease_factor);
+  } else {
+    target += config.increase;
+  }
+  target = std::clamp(target, config.min_bitrate, config.max_bitrate);
+  if (target == previous) {
+    return std::nullopt;
+  }
+  return target;
+}
+
+void BitrateController::set_target(int64_t target_) noexcept {
+  target = std::clamp(target_, config.min_bitrate, config.max_bitrate);
+}
+
+int64_t BitrateController::target_bitrate() const noexcept { return target; }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+struct BitrateControllerConfig {
+  // Bounds of the target bitrate in bits per second.
+  int64_t min_bitrate;
+  int64_t max_bitrate;
+  // Added to the target after a window without congestion.
+  int64_t increase;
+  // The target is multiplied by this after a congested window. In (0, 1).
+  double decrease_factor;
+  // Frames per decision.
+  uint32_t window_frames;
+  // A window is congested when more than this fraction of its frames found
+  // the encoder input full,
+  double input_full_threshold;
+  // or the produced bitrate exceeded the target by this factor.
+  double overshoot_threshold;
+};
+
+// Adjusts the target bitrate with additive increase and multiplicative
+// decrease based on congestion signals.
+//
+// Only depends on the sequence of observations so that recorded traces can be
+// replayed.
+class BitrateController {
+  BitrateControllerConfig config;
+  // Bits per frame at the target bitrate is target * frame_duration.
+  double frame_duration;
+  int64_t target;
+
+  uint32_t frames{0};
+  // Totals at the start of the window.
+  uint64_t input_full_start{0};
+  uint64_t bytes_start{0};
+
+public:
+  // frame_rate in frames per second.
+  BitrateController(const BitrateControllerConfig &, int64_t initial_target,
+                    double frame_rate) noexcept;
+
+  // Call once per frame with running totals of the frames that found the
+  // encoder input full and of the produced bytes. Returns the new target
+  // bitrate when it changed.
+  std::optional<int64_t> observe(uint64_t input_full_total,
+                                 uint64_t bytes_total) noexcept;
+
+  // Follows a target that was changed by someone else, for example the user.
+  void set_target(int64_t) noexcept;
+  int64_t target_bitrate() const noexcept;
+};
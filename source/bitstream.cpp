@@ -0,0 +1,451 @@
+#include "bitstream.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define BITSTREAM_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+constexpr uint8_t avc_slice{1};
+constexpr uint8_t avc_idr{5};
+constexpr uint8_t avc_sps{7};
+constexpr uint8_t avc_pps{8};
+constexpr uint8_t avc_filler{12};
+
+// Types 0 to 9 are non random access slices, 16 to 21 random access slices.
+constexpr uint8_t hevc_last_slice{9};
+constexpr uint8_t hevc_first_irap{16};
+constexpr uint8_t hevc_last_irap{21};
+constexpr uint8_t hevc_vps{32};
+constexpr uint8_t hevc_sps{33};
+constexpr uint8_t hevc_pps{34};
+constexpr uint8_t hevc_filler{38};
+
+constexpr std::array<uint8_t, 4> start_code{0, 0, 0, 1};
+
+uint8_t nal_type(Codec codec, uint8_t header) noexcept {
+  return codec == Codec::Avc ? header & 0x1F : (header >> 1) & 0x3F;
+}
+
+const uint8_t *find_start_code_scalar(const uint8_t *begin,
+                                      const uint8_t *end) noexcept {
+  for (auto *p{begin}; end - p >= 3; ++p) {
+    if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+      return p;
+    }
+  }
+  return end;
+}
+
+#ifdef BITSTREAM_X86
+
+unsigned trailing_zeros(unsigned mask) noexcept {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// Compressed data rarely contains zero bytes so checking 16 bytes at once for
+// any zero skips almost everything.
+const uint8_t *find_start_code_sse2(const uint8_t *begin,
+                                    const uint8_t *end) noexcept {
+  const auto zero{_mm_setzero_si128()};
+  auto *p{begin};
+  // Leave room for the two bytes after a zero in the last block.
+  for (; end - p >= 18; p += 16) {
+    const auto block{_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))};
+    auto mask{static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)))};
+    while (mask != 0) {
+      const auto *const candidate{p + trailing_zeros(mask)};
+      if (candidate[1] == 0 && candidate[2] == 1) {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return find_start_code_scalar(p, end);
+}
+
+#endif // BITSTREAM_X86
+
+// Reads Exp-Golomb coded values from the start of a NAL payload, skipping
+// emulation prevention bytes.
+class BitReader {
+  std::span<const uint8_t> data;
+  size_t byte{0};
+  int bit{0};
+  int zeros{0};
+  uint8_t current{0};
+  bool overrun{false};
+
+  bool next_byte() noexcept {
+    for (;;) {
+      if (byte >= data.size()) {
+        overrun = true;
+        return false;
+      }
+      current = data[byte++];
+      if (zeros >= 2 && current == 3) {
+        zeros = 0;
+        continue;
+      }
+      zeros = current == 0 ? zeros + 1 : 0;
+      return true;
+    }
+  }
+
+public:
+  explicit BitReader(std::span<const uint8_t> data_) noexcept
+      : data{data_} {}
+
+  uint32_t read_bit() noexcept {
+    if (bit == 0) {
+      if (!next_byte()) {
+        return 0;
+      }
+      bit = 8;
+    }
+    --bit;
+    return (current >> bit) & 1;
+  }
+
+  uint32_t read_bits(int count) noexcept {
+    uint32_t value{0};
+    for (int i{0}; i < count; ++i) {
+      value = (value << 1) | read_bit();
+    }
+    return value;
+  }
+
+  void skip_bits(int count) noexcept {
+    for (int i{0}; i < count; ++i) {
+      read_bit();
+    }
+  }
+
+  uint32_t read_ue() noexcept {
+    int leading_zeros{0};
+    while (read_bit() == 0) {
+      if (overrun || ++leading_zeros > 31) {
+        overrun = true;
+        return 0;
+      }
+    }
+    return (uint32_t{1} << leading_zeros) - 1 + read_bits(leading_zeros);
+  }
+
+  bool failed() const noexcept { return overrun; }
+};
+
+PacketPriority same(NalPriority priority) noexcept {
+  return {priority, priority};
+}
+
+std::optional<PacketPriority> classify_avc(const NalUnit &nal) noexcept {
+  if (nal.type == avc_idr) {
+    return same(NalPriority::Highest);
+  }
+  const auto ref_idc{(nal.data[0] >> 5) & 3};
+  if (ref_idc == 0) {
+    return same(NalPriority::Disposable);
+  }
+  BitReader reader{nal.data.subspan(1)};
+  reader.read_ue(); // first_mb_in_slice
+  const auto slice_type{reader.read_ue() % 5};
+  if (reader.failed()) {
+    return same(NalPriority::High);
+  }
+  // P, B, I, SP, SI. Referenced B-frames only matter to the frames between
+  // their own references so they go before P-frames.
+  return same(slice_type == 1 ? NalPriority::Low : NalPriority::High);
+}
+
+std::optional<PacketPriority> classify_hevc(const NalUnit &nal) noexcept {
+  if (nal.data.size() < 2) {
+    return std::nullopt;
+  }
+  if (nal.type >= hevc_first_irap && nal.type <= hevc_last_irap) {
+    return same(NalPriority::Highest);
+  }
+  // Even types below 16 are sub-layer non-reference pictures.
+  if (nal.type % 2 == 0) {
+    return same(NalPriority::Disposable);
+  }
+  const auto temporal_id{(nal.data[1] & 7) - 1};
+  return same(temporal_id == 0 ? NalPriority::High : NalPriority::Low);
+}
+
+bool is_slice(Codec codec, uint8_t type) noexcept {
+  if (codec == Codec::Avc) {
+    return type >= avc_slice && type <= avc_idr;
+  }
+  return type <= hevc_last_slice ||
+         (type >= hevc_first_irap && type <= hevc_last_irap);
+}
+
+bool is_parameter_set(Codec codec, uint8_t type) noexcept {
+  if (codec == Codec::Avc) {
+    return type == avc_sps || type == avc_pps;
+  }
+  return type >= hevc_vps && type <= hevc_pps;
+}
+
+void put_u16(std::vector<uint8_t> &out, size_t value) {
+  if (value > 0xFFFF) {
+    throw std::runtime_error("parameter set too large");
+  }
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+// Parameter sets of one type in stream order.
+std::vector<std::span<const uint8_t>>
+units_of_type(Codec codec, std::span<const uint8_t> data, uint8_t type) {
+  std::vector<std::span<const uint8_t>> units;
+  NalScanner scanner{codec, data};
+  while (const auto nal{scanner.next()}) {
+    if (nal->type == type) {
+      units.push_back(nal->data);
+    }
+  }
+  return units;
+}
+
+std::vector<uint8_t> make_avcc(std::span<const uint8_t> data) {
+  const auto sps{units_of_type(Codec::Avc, data, avc_sps)};
+  const auto pps{units_of_type(Codec::Avc, data, avc_pps)};
+  if (sps.empty() || pps.empty() || sps.front().size() < 4) {
+    throw std::runtime_error("avcC needs an SPS and a PPS");
+  }
+  // The counts are 5 and 8 bit fields.
+  if (sps.size() > 31 || pps.size() > 255) {
+    throw std::runtime_error("avcC holds at most 31 SPS and 255 PPS");
+  }
+  const auto profile{sps.front()[1]};
+  std::vector<uint8_t> out{1, profile, sps.front()[2], sps.front()[3],
+                           // Four byte NAL lengths.
+                           0xFF,
+                           static_cast<uint8_t>(0xE0 | sps.size())};
+  for (const auto unit : sps) {
+    put_u16(out, unit.size());
+    out.insert(out.end(), unit.begin(), unit.end());
+  }
+  out.push_back(static_cast<uint8_t>(pps.size()));
+  for (const auto unit : pps) {
+    put_u16(out, unit.size());
+    out.insert(out.end(), unit.begin(), unit.end());
+  }
+  // High profiles append the chroma format and bit depths.
+  if (profile == 100 || profile == 110 || profile == 122 || profile == 144) {
+    BitReader reader{sps.front().subspan(4)};
+    reader.read_ue(); // seq_parameter_set_id
+    const auto chroma_format{reader.read_ue()};
+    if (chroma_format == 3) {
+      reader.read_bit(); // separate_colour_plane_flag
+    }
+    const auto bit_depth_luma{reader.read_ue()};
+    const auto bit_depth_chroma{reader.read_ue()};
+    if (reader.failed()) {
+      throw std::runtime_error("truncated SPS");
+    }
+    out.push_back(static_cast<uint8_t>(0xFC | (chroma_format & 3)));
+    out.push_back(static_cast<uint8_t>(0xF8 | (bit_depth_luma & 7)));
+    out.push_back(static_cast<uint8_t>(0xF8 | (bit_depth_chroma & 7)));
+    out.push_back(0);
+  }
+  return out;
+}
+
+std::vector<uint8_t> make_hvcc(std::span<const uint8_t> data) {
+  const auto vps{units_of_type(Codec::Hevc, data, hevc_vps)};
+  const auto sps{units_of_type(Codec::Hevc, data, hevc_sps)};
+  const auto pps{units_of_type(Codec::Hevc, data, hevc_pps)};
+  if (vps.empty() || sps.empty() || pps.empty()) {
+    throw std::runtime_error("hvcC needs a VPS, an SPS and a PPS");
+  }
+
+  BitReader reader{sps.front().subspan(2)};
+  reader.skip_bits(4); // sps_video_parameter_set_id
+  const auto max_sub_layers_minus1{reader.read_bits(3)};
+  const auto temporal_id_nesting{reader.read_bit()};
+  // general_profile_tier_level is byte aligned and copied as is.
+  std::array<uint8_t, 12> general_profile{};
+  for (auto &byte : general_profile) {
+    byte = static_cast<uint8_t>(reader.read_bits(8));
+  }
+  std::array<bool, 8> sub_layer_profile{};
+  std::array<bool, 8> sub_layer_level{};
+  for (uint32_t i{0}; i < max_sub_layers_minus1; ++i) {
+    sub_layer_profile[i] = reader.read_bit();
+    sub_layer_level[i] = reader.read_bit();
+  }
+  if (max_sub_layers_minus1 > 0) {
+    reader.skip_bits(2 * (8 - static_cast<int>(max_sub_layers_minus1)));
+  }
+  for (uint32_t i{0}; i < max_sub_layers_minus1; ++i) {
+    reader.skip_bits((sub_layer_profile[i] ? 88 : 0) +
+                     (sub_layer_level[i] ? 8 : 0));
+  }
+  reader.read_ue(); // sps_seq_parameter_set_id
+  const auto chroma_format{reader.read_ue()};
+  if (chroma_format == 3) {
+    reader.read_bit(); // separate_colour_plane_flag
+  }
+  reader.read_ue(); // pic_width_in_luma_samples
+  reader.read_ue(); // pic_height_in_luma_samples
+  if (reader.read_bit()) {
+    // conformance window offsets
+    for (int i{0}; i < 4; ++i) {
+      reader.read_ue();
+    }
+  }
+  const auto bit_depth_luma{reader.read_ue()};
+  const auto bit_depth_chroma{reader.read_ue()};
+  if (reader.failed()) {
+    throw std::runtime_error("truncated SPS");
+  }
+
+  std::vector<uint8_t> out{1};
+  out.insert(out.end(), general_profile.begin(), general_profile.end());
+  // min_spatial_segmentation_idc and parallelismType unknown.
+  out.insert(out.end(), {0xF0, 0x00, 0xFC});
+  out.push_back(static_cast<uint8_t>(0xFC | (chroma_format & 3)));
+  out.push_back(static_cast<uint8_t>(0xF8 | (bit_depth_luma & 7)));
+  out.push_back(static_cast<uint8_t>(0xF8 | (bit_depth_chroma & 7)));
+  // avgFrameRate unknown.
+  out.insert(out.end(), {0, 0});
+  // constantFrameRate unknown, four byte NAL lengths.
+  out.push_back(static_cast<uint8_t>(((max_sub_layers_minus1 + 1) << 3) |
+                                     (temporal_id_nesting << 2) | 3));
+  out.push_back(3);
+  const std::array<std::pair<uint8_t, const decltype(vps) *>, 3> arrays{
+      {{hevc_vps, &vps}, {hevc_sps, &sps}, {hevc_pps, &pps}}};
+  for (const auto &[type, units] : arrays) {
+    // array_completeness set because parameter sets are only sent here.
+    out.push_back(static_cast<uint8_t>(0x80 | type));
+    put_u16(out, units->size());
+    for (const auto unit : *units) {
+      put_u16(out, unit.size());
+      out.insert(out.end(), unit.begin(), unit.end());
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+const uint8_t *find_start_code(const uint8_t *begin,
+                               const uint8_t *end) noexcept {
+#ifdef BITSTREAM_X86
+  // SSE2 is part of x86-64.
+  return find_start_code_sse2(begin, end);
+#else
+  return find_start_code_scalar(begin, end);
+#endif
+}
+
+NalScanner::NalScanner(Codec codec_, std::span<const uint8_t> data) noexcept
+    : codec{codec_}, position{find_start_code(data.data(),
+                                              data.data() + data.size())},
+      end{data.data() + data.size()}, unit_end{data.data()} {}
+
+std::optional<NalUnit> NalScanner::next() noexcept {
+  while (position != end) {
+    const auto *const payload{position + 3};
+    position = find_start_code(payload, end);
+    // Zero bytes before the next start code are either trailing_zero_8bits or
+    // the first byte of a four byte start code. Either way they go with the
+    // next unit.
+    auto *payload_end{position};
+    while (payload_end > payload && payload_end[-1] == 0) {
+      --payload_end;
+    }
+    const auto *const unit_begin{unit_end};
+    unit_end = payload_end;
+    if (payload_end == payload) {
+      continue;
+    }
+    return NalUnit{
+        .data = {payload, payload_end},
+        .with_start_code = {unit_begin, payload_end},
+        .type = nal_type(codec, *payload),
+    };
+  }
+  return std::nullopt;
+}
+
+std::optional<PacketPriority>
+classify_packet(Codec codec, std::span<const uint8_t> data) noexcept {
+  NalScanner scanner{codec, data};
+  while (const auto nal{scanner.next()}) {
+    // All slices of a picture have the same type and reference flags so the
+    // first one decides and the rest of the packet need not be scanned.
+    if (is_slice(codec, nal->type)) {
+      return codec == Codec::Avc ? classify_avc(*nal) : classify_hevc(*nal);
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<uint8_t> find_parameter_sets(Codec codec,
+                                         std::span<const uint8_t> data) {
+  std::vector<uint8_t> out;
+  NalScanner scanner{codec, data};
+  while (const auto nal{scanner.next()}) {
+    if (is_slice(codec, nal->type)) {
+      break;
+    }
+    if (is_parameter_set(codec, nal->type)) {
+      out.insert(out.end(), start_code.begin(), start_code.end());
+      out.insert(out.end(), nal->data.begin(), nal->data.end());
+    }
+  }
+  return out;
+}
+
+std::vector<uint8_t> make_configuration_record(Codec codec,
+                                               std::span<const uint8_t> data) {
+  return codec == Codec::Avc ? make_avcc(data) : make_hvcc(data);
+}
+
+size_t strip_filler_data(Codec codec, std::span<uint8_t> data) noexcept {
+  const auto filler{codec == Codec::Avc ? avc_filler : hevc_filler};
+  auto *const begin{data.data()};
+  // Bytes before write are final. Bytes from kept_from up to the current unit
+  // are kept but not moved yet.
+  auto *write{begin};
+  const uint8_t *kept_from{begin};
+  NalScanner scanner{codec, data};
+  while (const auto nal{scanner.next()}) {
+    if (nal->type != filler) {
+      continue;
+    }
+    const auto *const unit_begin{nal->with_start_code.data()};
+    const auto kept{static_cast<size_t>(unit_begin - kept_from)};
+    // Everything moved is before the unit so the scanner does not see it.
+    if (write != kept_from) {
+      std::memmove(write, kept_from, kept);
+    }
+    write += kept;
+    kept_from = unit_begin + nal->with_start_code.size();
+  }
+  const auto rest{static_cast<size_t>(begin + data.size() - kept_from)};
+  if (write != kept_from) {
+    std::memmove(write, kept_from, rest);
+  }
+  return static_cast<size_t>(write - begin) + rest;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Parsing of Annex-B H.264 and H.265 bitstreams as produced by the encoder.
+// Nothing here allocates so it is cheap enough to run on every packet.
+
+enum class Codec { Avc, Hevc };
+
+// First byte of the next 00 00 01 start code in [begin, end) or end.
+const uint8_t *find_start_code(const uint8_t *begin,
+                               const uint8_t *end) noexcept;
+
+// One NAL unit without its start code. The payload includes the header and
+// may still contain emulation prevention bytes.
+struct NalUnit {
+  std::span<const uint8_t> data;
+  // Also includes the start code and the zero bytes before it. Consecutive
+  // units are adjacent so removing one leaves a valid stream.
+  std::span<const uint8_t> with_start_code;
+  uint8_t type;
+};
+
+// Iterates the NAL units of an Annex-B buffer.
+class NalScanner {
+  Codec codec;
+  const uint8_t *position;
+  const uint8_t *end;
+  // End of the previous unit's payload.
+  const uint8_t *unit_end;
+
+public:
+  NalScanner(Codec, std::span<const uint8_t>) noexcept;
+
+  std::optional<NalUnit> next() noexcept;
+};
+
+// How important a packet is for decoding the frames after it. The values
+// equal OBS_NAL_PRIORITY_* so that this does not depend on OBS.
+enum class NalPriority { Disposable = 0, Low = 1, High = 2, Highest = 3 };
+
+struct PacketPriority {
+  NalPriority priority;
+  NalPriority drop_priority;
+};
+
+// Classifies a packet by its first slice: IDR and other random access
+// pictures are highest, pictures nothing refers to are disposable and the
+// rest is in between depending on slice type (AVC) or temporal layer (HEVC).
+// Returns nullopt when the packet has no slice.
+std::optional<PacketPriority>
+classify_packet(Codec, std::span<const uint8_t>) noexcept;
+
+// The VPS, SPS and PPS units before the first slice as Annex-B with four byte
+// start codes. Empty when there are none.
+std::vector<uint8_t> find_parameter_sets(Codec, std::span<const uint8_t>);
+
+// The avcC or hvcC record from ISO/IEC 14496-15 for Annex-B parameter sets.
+// Throws std::runtime_error when a required parameter set is missing or there
+// are more than the record can hold.
+std::vector<uint8_t> make_configuration_record(Codec,
+                                               std::span<const uint8_t>);
+
+// Removes filler data units (AVC type 12, HEVC type 38) by moving the rest of
+// the buffer forward. Returns the new size. Does nothing when there are none.
+size_t strip_filler_data(Codec, std::span<uint8_t>) noexcept;
@@ -0,0 +1,92 @@
+#include "device_registry.h"
+
+#include "util.h"
+
+#include <fmt/core.h>
+
+#include <combaseapi.h>
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// PCI vendor id of AMD.
+constexpr UINT amd_vendor_id{0x1002};
+
+CComPtr<IDXGIAdapter> find_adapter(uint32_t index) {
+  CComPtr<IDXGIFactory> d11_factory;
+  if (CreateDXGIFactory1(IID_PPV_ARGS(&d11_factory)) < 0) {
+    throw std::runtime_error("CreateDXGIFactory1");
+  }
+  CComPtr<IDXGIAdapter> adapter;
+  if (d11_factory->EnumAdapters(index, &adapter) < 0) {
+    throw std::runtime_error("EnumAdapters");
+  }
+  return adapter;
+}
+
+std::mutex registry_mutex;
+// Entries expire when the last encoder on the adapter is destroyed.
+std::map<uint32_t, std::weak_ptr<SharedDevice>> registry;
+
+} // namespace
+
+SharedDevice::SharedDevice(uint32_t adapter_)
+    : adapter{adapter_}, amf_factory{&amf.init()} {
+  const auto dxgi_adapter{find_adapter(adapter)};
+  dxgi_adapter->GetDesc(&adapter_desc);
+  if (adapter_desc.VendorId != amd_vendor_id) {
+    throw std::runtime_error(
+        fmt::format("invalid vendor {}", adapter_desc.VendorId));
+  }
+  LARGE_INTEGER umd_version;
+  if (dxgi_adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice),
+                                          &umd_version) >= 0) {
+    driver_version = umd_version.QuadPart;
+  }
+  if (D3D11CreateDevice(dxgi_adapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0,
+                        nullptr, 0, D3D11_SDK_VERSION, &d11_device, nullptr,
+                        &d11_context) < 0) {
+    throw std::runtime_error("D3D11CreateDevice");
+  }
+  if (amf_factory->CreateContext(&amf_context) != AMF_OK) {
+    throw std::runtime_error("AMFFactory::CreateContext");
+  }
+  if (amf_context->InitDX11(d11_device) != AMF_OK) {
+    throw std::runtime_error("AMFContext::InitDX11");
+  }
+}
+
+bool is_amd_adapter(uint32_t adapter) noexcept {
+  try {
+    DXGI_ADAPTER_DESC desc;
+    return find_adapter(adapter)->GetDesc(&desc) >= 0 &&
+           desc.VendorId == amd_vendor_id;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+std::shared_ptr<SharedDevice> acquire_shared_device(uint32_t adapter) {
+  // Held while creating so that concurrent encoders on the same adapter end up
+  // with one device.
+  std::scoped_lock lock{registry_mutex};
+  auto &entry{registry[adapter]};
+  if (auto device = entry.lock()) {
+    log(LOG_DEBUG, "reusing device for adapter {}", adapter);
+    return device;
+  }
+  auto device{std::make_shared<SharedDevice>(adapter)};
+  entry = device;
+  return device;
+}
+
+Dx11Lock::Dx11Lock(amf::AMFContext &context_) : context{context_} {
+  if (context.LockDX11() != AMF_OK) {
+    throw std::runtime_error("AMFContext::LockDX11");
+  }
+}
+
+Dx11Lock::~Dx11Lock() noexcept { context.UnlockDX11(); }
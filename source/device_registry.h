@@ -0,0 +1,60 @@
+#pragma once
+
+#include "amf.h"
+#include "gsl.h"
+
+#include <AMF/core/Context.h>
+#include <AMF/core/Factory.h>
+
+#include <atlbase.h>
+#include <d3d11.h>
+#include <dxgi.h>
+
+#include <cstdint>
+#include <memory>
+
+// D3D11 device, AMF runtime and AMF context for one adapter. Shared by all
+// encoders on that adapter so that streaming and recording at the same time do
+// not each load AMF and create a device.
+//
+// The immediate context is not thread safe and encoders run on different
+// threads. Every use of d11_context outside of AMF must hold a Dx11Lock.
+struct SharedDevice {
+  uint32_t adapter;
+  DXGI_ADAPTER_DESC adapter_desc;
+  // User mode driver version as reported by DXGI. 0 when unknown.
+  int64_t driver_version{0};
+  CComPtr<ID3D11Device> d11_device;
+  CComPtr<ID3D11DeviceContext> d11_context;
+  Amf amf;
+  // Lifetime is tied to amf.
+  not_null<amf::AMFFactory *> amf_factory;
+  // Based on d11_device.
+  amf::AMFContextPtr amf_context;
+
+  explicit SharedDevice(uint32_t adapter);
+
+  SharedDevice(const SharedDevice &) = delete;
+  SharedDevice &operator=(const SharedDevice &) = delete;
+};
+
+// Whether the adapter is made by AMD. False when it does not exist. Cheap
+// compared to creating a SharedDevice which loads the AMF runtime first.
+bool is_amd_adapter(uint32_t adapter) noexcept;
+
+// Returns the device for the adapter. Creates it if no one else holds it.
+// Thread safe.
+std::shared_ptr<SharedDevice> acquire_shared_device(uint32_t adapter);
+
+// Holds AMF's DX11 lock which serializes use of the immediate context with AMF
+// and other encoders.
+class Dx11Lock {
+  amf::AMFContext &context;
+
+public:
+  explicit Dx11Lock(amf::AMFContext &);
+  ~Dx11Lock() noexcept;
+
+  Dx11Lock(const Dx11Lock &) = delete;
+  Dx11Lock &operator=(const Dx11Lock &) = delete;
+};
@@ -0,0 +1,44 @@
+#include "dts_generator.h"
+
+#include <algorithm>
+
+DtsGenerator::DtsGenerator(int64_t reorder_depth_,
+                           int64_t frame_duration_) noexcept
+    : reorder_depth{reorder_depth_}, frame_duration{frame_duration_} {}
+
+void DtsGenerator::submitted(int64_t pts) {
+  if (!first_pts) {
+    first_pts = pts;
+  }
+  pending.push_back(pts);
+}
+
+int64_t DtsGenerator::next(int64_t pts) {
+  int64_t dts;
+  const auto index{static_cast<int64_t>(packets++)};
+  if (index < reorder_depth) {
+    // The first packets are decoded before the first frame is presented.
+    dts = first_pts.value_or(pts) - (reorder_depth - index) * frame_duration;
+  } else if (!pending.empty()) {
+    dts = pending.front();
+    pending.pop_front();
+  } else {
+    // More packets than frames. Cannot happen with a well behaved encoder.
+    dts = pts;
+  }
+
+  if (dts > pts || (last_dts && dts <= *last_dts)) {
+    ++violations;
+    // As late as allowed but after the previous packet. When the PTS is not
+    // after the previous DTS no valid value exists. Muxers reject decreasing
+    // DTS outright so increasing wins over not exceeding the PTS.
+    dts = std::min(dts, pts);
+    if (last_dts) {
+      dts = std::max(dts, *last_dts + 1);
+    }
+  }
+  last_dts = dts;
+  return dts;
+}
+
+uint64_t DtsGenerator::violation_count() const noexcept { return violations; }
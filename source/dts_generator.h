@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// Derives decode timestamps for packets that the encoder outputs in a
+// different order than the frames were submitted because of B-frames.
+//
+// Frames are submitted in presentation order. With a reorder depth of D the
+// k-th packet is decoded at the presentation time of the (k-D)-th submitted
+// frame. The first D packets get timestamps extrapolated to before the first
+// frame. This keeps DTS strictly increasing and never greater than PTS as long
+// as no frame is presented more than D frames after it is decoded, which also
+// holds for adaptive mini-GOP because it only ever shortens the pattern.
+//
+// Does not log so that it can be tested without OBS.
+class DtsGenerator {
+  int64_t reorder_depth;
+  // PTS ticks per frame. OBS advances the PTS by the frame rate denominator.
+  int64_t frame_duration;
+  // PTS of submitted frames whose DTS has not been handed out, oldest first.
+  std::deque<int64_t> pending;
+  std::optional<int64_t> first_pts;
+  uint64_t packets{0};
+  std::optional<int64_t> last_dts;
+  uint64_t violations{0};
+
+public:
+  explicit DtsGenerator(int64_t reorder_depth = 0,
+                        int64_t frame_duration = 1) noexcept;
+
+  // Call for every frame the encoder accepted.
+  void submitted(int64_t pts);
+  // Call for every packet in output order.
+  int64_t next(int64_t pts);
+  // Number of packets for which the reorder depth was too small. Their DTS is
+  // repaired as well as possible.
+  uint64_t violation_count() const noexcept;
+};
@@ -1,19 +1,30 @@
 #include "encoder.h"
 
+#include "log_sink.h"
+#include "plane_copy.h"
 #include "settings.h"
 #include "util.h"
+#include "warm_up.h"
 
 #include <AMF/components/ColorSpace.h>
+#include <AMF/components/ComponentCaps.h>
 #include <AMF/core/Data.h>
 #include <AMF/core/Factory.h>
 #include <fmt/core.h>
+#include <obs-avc.h>
 #include <obs-module.h>
 
-#include <combaseapi.h>
-#include <dxgi.h>
-
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <exception>
+#include <filesystem>
+#include <limits>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
 
 namespace {
 
@@ -88,90 +99,242 @@ Color obs_color_space_to_amf(video_colorspace obs_space,
   return color;
 }
 
+// When a pool is given and the frame is at least parallel_threshold bytes the
+// planes are split into bands of rows that are copied concurrently.
 static void copy_obs_frame_to_amf_surface(const encoder_frame &frame,
-                                          amf::AMFSurface &surface) {
+                                          amf::AMFSurface &surface,
+                                          WorkerPool *pool,
+                                          size_t parallel_threshold) {
   const size_t plane_count{surface.GetPlanesCount()};
+  std::array<PlaneCopy, MAX_AV_PLANES> copies;
+  ASSERT_(plane_count <= copies.size());
+  size_t total_bytes{0};
   for (size_t i{0}; i < plane_count; ++i) {
     auto &plane = *surface.GetPlaneAt(i);
-    const auto plane_data = static_cast<uint8_t *>(plane.GetNative());
-    const auto height{static_cast<size_t>(plane.GetHeight())};
+    // Only copy the visible part of each row. Both sides may be padded.
+    const auto row_bytes{static_cast<size_t>(plane.GetWidth()) *
+                         static_cast<size_t>(plane.GetPixelSizeInBytes())};
     const auto plane_linesize{static_cast<size_t>(plane.GetHPitch())};
-    const auto *const frame_data{frame.data[i]};
     const auto frame_linesize{static_cast<size_t>(frame.linesize[i])};
-    if (plane_linesize > frame_linesize) {
-      for (size_t line{0}; line < height; ++line) {
-        std::memcpy(plane_data + plane_linesize * line,
-                    frame_data + frame_linesize * line, frame_linesize);
-      }
-    } else if (plane_linesize == frame_linesize) {
-      std::memcpy(plane_data, frame_data, plane_linesize * height);
-    } else {
-      throw std::runtime_error(
-          fmt::format("plane {} linesize {} is smaller than frame linesize {}",
-                      i, plane_linesize, frame_linesize));
+    if (plane_linesize < row_bytes || frame_linesize < row_bytes) {
+      throw std::runtime_error(fmt::format(
+          "plane {} linesize {} or frame linesize {} is smaller than row {}",
+          i, plane_linesize, frame_linesize, row_bytes));
     }
+    copies[i] = {
+        .dst = static_cast<uint8_t *>(plane.GetNative()),
+        .dst_pitch = plane_linesize,
+        .src = frame.data[i],
+        .src_pitch = frame_linesize,
+        .row_bytes = row_bytes,
+        .rows = static_cast<size_t>(plane.GetHeight()),
+    };
+    total_bytes += row_bytes * copies[i].rows;
   }
+  // The encoder reads the surface through DMA so there is no point in keeping
+  // it in the CPU cache when it does not fit anyway.
+  const auto streaming{prefer_streaming_stores(total_bytes)};
+
+  if (!pool || total_bytes < parallel_threshold) {
+    for (size_t i{0}; i < plane_count; ++i) {
+      copy_plane(copies[i], streaming);
+    }
+    return;
+  }
+
+  // Split every plane into one band per thread so that the work is even even
+  // though chroma planes are smaller than luma planes.
+  const auto bands_per_plane{pool->thread_count()};
+  const auto copy_band = [&](size_t task) noexcept {
+    const auto &plane{copies[task / bands_per_plane]};
+    const auto band{task % bands_per_plane};
+    const auto band_rows{(plane.rows + bands_per_plane - 1) / bands_per_plane};
+    const auto first_row{band * band_rows};
+    if (first_row >= plane.rows) {
+      return;
+    }
+    auto part{plane};
+    part.dst += first_row * plane.dst_pitch;
+    part.src += first_row * plane.src_pitch;
+    part.rows = std::min(band_rows, plane.rows - first_row);
+    copy_plane(part, streaming);
+  };
+  pool->parallel_for(plane_count * bands_per_plane, copy_band);
 }
 
+// Number of back to back queries in OutputMode::BoundedWait before we start
+// yielding the thread between queries.
+constexpr size_t bounded_wait_spins{64};
+
+// AMF does not report how many input frames it holds before returning
+// AMF_INPUT_FULL. We assume this many besides the ones held back for
+// reordering. Running out is counted in the stats and the texture ring size
+// option overrides the estimate.
+constexpr size_t encoder_input_depth{6};
+
 // The PTS as it was given to us by OBS. Stored in encoder input so that we can
 // assign it to the obs output packet.
 const not_null<cwzstring> pts_property{L"obs_pts"};
 
+// Copy of the settings that includes the defaults so that values the user never
+// changed compare equal.
+ObsData snapshot(obs_data &data) {
+  ObsData copy{obs_data_get_defaults(&data), obs_data_release};
+  obs_data_apply(copy.get(), &data);
+  return copy;
+}
+
+// OBS sets the bitrate in kbps under this key. Used by dynamic bitrate and by
+// the simple output mode.
+constexpr czstring obs_bitrate{"bitrate"};
+
+// Maps a changed OBS bitrate onto our settings. The peak bitrate keeps its
+// ratio to the target bitrate.
+void apply_obs_bitrate(obs_data &applied, obs_data &data) {
+  const auto kbps{obs_data_get_int(&data, obs_bitrate)};
+  if (kbps <= 0 || kbps == obs_data_get_int(&applied, obs_bitrate)) {
+    return;
+  }
+  const int64_t target{kbps * 1000};
+  const int64_t old_target{obs_data_get_int(&applied, "target bit rate")};
+  const int64_t old_peak{obs_data_get_int(&applied, "peak bit rate")};
+  const auto peak{old_target > 0 ? old_peak * target / old_target : target};
+  const int64_t max{std::numeric_limits<int>::max()};
+  obs_data_set_int(&data, "target bit rate", std::min(target, max));
+  obs_data_set_int(&data, "peak bit rate", std::min(peak, max));
+  log(LOG_INFO, "bitrate changed to {} kbps", kbps);
+}
+
+// Frames kept for the rolling telemetry summary and written to the telemetry
+// file at once.
+constexpr size_t telemetry_capacity{1024};
+
+// Feedback properties are optional so missing ones are not errors.
+int64_t optional_int(amf::AMFPropertyStorage &storage,
+                     not_null<cwzstring> name) noexcept {
+  int64_t value;
+  return storage.GetProperty(name, &value) == AMF_OK ? value : -1;
+}
+
+double optional_double(amf::AMFPropertyStorage &storage,
+                       not_null<cwzstring> name) noexcept {
+  double value;
+  return storage.GetProperty(name, &value) == AMF_OK
+             ? value
+             : std::numeric_limits<double>::quiet_NaN();
+}
+
+static_assert(static_cast<int>(NalPriority::Disposable) ==
+              OBS_NAL_PRIORITY_DISPOSABLE);
+static_assert(static_cast<int>(NalPriority::Low) == OBS_NAL_PRIORITY_LOW);
+static_assert(static_cast<int>(NalPriority::High) == OBS_NAL_PRIORITY_HIGH);
+static_assert(static_cast<int>(NalPriority::Highest) ==
+              OBS_NAL_PRIORITY_HIGHEST);
+
+int obs_nal_priority(NalPriority priority) noexcept {
+  return static_cast<int>(priority);
+}
+
+// Whether the initialized encoder takes a new value for the property. Static
+// properties may be refused or silently kept so the value is read back. The
+// original value is restored.
+template <AmfVariant T>
+bool changes_after_init(amf::AMFPropertyStorage &storage,
+                        not_null<cwzstring> name, const T &original,
+                        const T &probe) noexcept {
+  T applied{original};
+  const auto changed{storage.SetProperty(name, probe) == AMF_OK &&
+                     storage.GetProperty(name, &applied) == AMF_OK &&
+                     applied == probe};
+  storage.SetProperty(name, original);
+  return changed;
+}
+
 } // namespace
 
 Encoder::Encoder(EncoderDetails details_) : details{details_} {}
 
+Encoder::~Encoder() noexcept {
+  if (stats.frames_submitted == 0) {
+    return;
+  }
+  try {
+    report_stats();
+  } catch (const std::exception &e) {
+    log(LOG_ERROR, "Error: report_stats: {}", e.what());
+  }
+}
+
 void Encoder::finish_construction(obs_data &obs_data,
                                   obs_encoder &obs_encoder) {
-  initialize_dx11();
-
-  auto &amf_factory{amf.init()};
-  if (amf_factory.CreateContext(&amf_context) != AMF_OK) {
-    throw std::runtime_error("AMFFactory::CreateContext");
+  options = Options{obs_data};
+  log(LOG_INFO, "plane copy kernel: {}", plane_copy_kernel_name());
+  if (options.copy_threads > 1) {
+    copy_pool.emplace(options.copy_threads);
   }
-  if (amf_context->InitDX11(d11_device) != AMF_OK) {
-    throw std::runtime_error("AMFContext::InitDX11");
+  obs_video_info info;
+  if (!obs_get_video_info(&info)) {
+    throw std::runtime_error("obs_get_video_info");
   }
+  shared_device = acquire_shared_device(info.adapter);
+  release_warm_device();
+  caps = get_encoder_caps(*shared_device, *details.caps_properties);
 
-  if (amf_factory.CreateComponent(amf_context, details.amf_encoder_name,
-                                  &amf_encoder) != AMF_OK) {
+  if (shared_device->amf_factory->CreateComponent(
+          shared_device->amf_context, details.amf_encoder_name,
+          &amf_encoder) != AMF_OK) {
     throw std::runtime_error("AMFFactory::CreateComponent");
   }
   apply_settings(obs_data, obs_encoder);
+  applied_settings = snapshot(obs_data);
+  switch (options.output_mode) {
+  case OutputMode::Poll:
+    break;
+  case OutputMode::DrainThread:
+    configure_query_timeout(OutputDrain::query_timeout);
+    break;
+  case OutputMode::BoundedWait:
+    // The property has millisecond granularity. Round up so that short
+    // budgets still wait.
+    configure_query_timeout(std::chrono::ceil<std::chrono::milliseconds>(
+        options.output_wait_budget));
+    break;
+  }
   if (amf_encoder->Init(surface_format, width, height) != AMF_OK) {
     throw std::runtime_error("AMFComponent::Init");
   }
-
-  texture_encoder.emplace(amf_context, d11_device, d11_context, width, height,
-                          surface_format);
+  const auto depth{reorder_depth(*amf_encoder)};
+  log(LOG_INFO, "reorder depth {}", depth);
+  dts_generator = DtsGenerator{depth, frame_duration};
+  texture_ring_size = options.texture_ring_size > 0
+                          ? options.texture_ring_size
+                          : encoder_input_depth + static_cast<size_t>(depth) +
+                                options.pending_input_capacity;
 
   set_extra_data();
-}
-
-void Encoder::initialize_dx11() {
-  obs_video_info info;
-  if (!obs_get_video_info(&info)) {
-    throw std::runtime_error("obs_get_video_info");
+  if (options.adaptive_bitrate) {
+    start_bitrate_controller();
   }
-  CComPtr<IDXGIFactory> d11_factory;
-  if (CreateDXGIFactory1(IID_PPV_ARGS(&d11_factory)) < 0) {
-    throw std::runtime_error("CreateDXGIFactory1");
+  if (options.overload_governor) {
+    start_overload_governor();
   }
-  CComPtr<IDXGIAdapter> adapter;
-  if (d11_factory->EnumAdapters(info.adapter, &adapter) < 0) {
-    throw std::runtime_error("EnumAdapters");
+
+  if (options.output_mode == OutputMode::DrainThread) {
+    output_drain.emplace(amf_encoder, options.output_queue_capacity,
+                         query_timeout_supported);
   }
-  DXGI_ADAPTER_DESC desc;
-  adapter->GetDesc(&desc);
-  // TODO: what is this constant?
-  if (desc.VendorId != 0x1002) {
-    throw std::runtime_error(fmt::format("invalid vendor {}", desc.VendorId));
+
+  if (!options.stats_file.empty()) {
+    try {
+      stats_file.emplace(options.stats_file);
+    } catch (const std::exception &e) {
+      log(LOG_WARNING, "stats file: {}", e.what());
+    }
   }
-  if (D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0, nullptr,
-                        0, D3D11_SDK_VERSION, &d11_device, nullptr,
-                        &d11_context) < 0) {
-    throw std::runtime_error("D3D11CreateDevice");
+  if (options.telemetry) {
+    start_telemetry();
   }
+  next_stats_report = std::chrono::steady_clock::now() + options.stats_interval;
 }
 
 void Encoder::apply_settings(obs_data &data, obs_encoder &obs_encoder) {
@@ -183,9 +346,19 @@ void Encoder::apply_settings(obs_data &data, obs_encoder &obs_encoder) {
   surface_format = obs_format_to_amf(voi.format);
 
   configure_encoder_with_obs_user_settings(*amf_encoder, data);
+  // Invalid settings make Init fail without saying why.
+  enforce_setting_limits(data, *amf_encoder, details.setting_limits(caps));
   // important for rate control
   set_property_fallible(*amf_encoder, details.frame_rate_property,
                         AMFConstructRate(voi.fps_num, voi.fps_den));
+  frame_rate = static_cast<double>(voi.fps_num) / voi.fps_den;
+  frame_duration = voi.fps_den;
+  const auto macroblocks{static_cast<int64_t>((width + 15) / 16) *
+                         ((height + 15) / 16) * voi.fps_num / voi.fps_den};
+  if (caps.max_throughput > 0 && macroblocks > caps.max_throughput) {
+    log(LOG_WARNING, "{} macroblocks per second exceed encoder maximum {}",
+        macroblocks, caps.max_throughput);
+  }
 
   const auto color = obs_color_space_to_amf(voi.colorspace, voi.range);
   set_color_range(*amf_encoder, color.range);
@@ -207,16 +380,67 @@ void Encoder::apply_settings(obs_data &data, obs_encoder &obs_encoder) {
 }
 
 void Encoder::set_extra_data() {
-  const auto variant{
-      get_property<amf::AMFVariant>(*amf_encoder, details.extra_data_property)};
-  if (variant.type != amf::AMF_VARIANT_INTERFACE) {
-    throw std::runtime_error("extradata property is not interface");
+  amf::AMFVariant variant;
+  if (amf_encoder->GetProperty(details.extra_data_property, &variant) !=
+          AMF_OK ||
+      variant.type != amf::AMF_VARIANT_INTERFACE) {
+    log(LOG_WARNING, "no extradata property, waiting for the first keyframe");
+    return;
   }
   auto &buffer{*static_cast<amf::AMFBuffer *>(variant.pInterface)};
-  const auto size{buffer.GetSize()};
-  extra_data.resize(size);
-  std::memcpy(extra_data.data(), buffer.GetNative(), size);
+  publish_extra_data(find_parameter_sets(
+      details.codec, {static_cast<const uint8_t *>(buffer.GetNative()),
+                      buffer.GetSize()}));
+}
+
+void Encoder::refresh_extra_data(std::span<const uint8_t> packet) {
+  auto found{find_parameter_sets(details.codec, packet)};
+  if (found.empty() || found == parameter_sets) {
+    return;
+  }
+  if (!parameter_sets.empty()) {
+    log(LOG_INFO, "parameter sets changed, refreshing extra data");
+  }
+  publish_extra_data(std::move(found));
 }
+
+void Encoder::publish_extra_data(std::vector<uint8_t> found) {
+  auto published{found};
+  if (options.extra_data_format == ExtraDataFormat::ConfigurationRecord &&
+      !found.empty()) {
+    try {
+      published = make_configuration_record(details.codec, found);
+    } catch (const std::exception &e) {
+      log(LOG_WARNING, "cannot build configuration record, using Annex B: {}",
+          e.what());
+    }
+  }
+  parameter_sets = std::move(found);
+  std::scoped_lock lock{extra_data_mutex};
+  if (!extra_data.empty()) {
+    retired_extra_data.push_back(std::move(extra_data));
+  }
+  extra_data = std::move(published);
+}
+
+void Encoder::configure_query_timeout(std::chrono::milliseconds timeout) {
+  amf::AMFCapsPtr caps;
+  if (amf_encoder->GetCaps(&caps) == AMF_OK) {
+    // Not every runtime reports the capability. Treat missing as unsupported.
+    bool supported{false};
+    if (caps->GetProperty(details.query_timeout_support_cap, &supported) ==
+        AMF_OK) {
+      query_timeout_supported = supported;
+    }
+  }
+  if (!query_timeout_supported) {
+    log(LOG_INFO, "query timeout unsupported, polling for output");
+    return;
+  }
+  set_property(*amf_encoder, details.query_timeout_property,
+               static_cast<int64_t>(timeout.count()));
+}
+
 bool Encoder::encode(SurfaceType surface_type, encoder_packet &packet,
                      bool &received_packet) noexcept {
   // The OBS encoder interface expects one input frame to be immediately
@@ -240,26 +464,294 @@ bool Encoder::encode(SurfaceType surface_type, encoder_packet &packet,
   //
   // We attempt to retrive a packet first before submitting a new frame
   // because this ensures that we cannot run into a full input queue.
+  //
+  // With OutputMode::DrainThread output is polled concurrently on another
+  // thread. That removes the one frame delay in the common case and lets us
+  // submit first so the drain thread gets as much time as possible to pick up
+  // the previous frame.
+  //
+  // With OutputMode::BoundedWait we implement the alternative described above.
+  // The encoder is usually done with a frame well within a frame interval so
+  // this removes the one frame delay at the cost of blocking.
+  const auto retrieve = [&]() noexcept {
+    try {
+      received_packet = retrieve_packet_from_encoder(packet);
+      return true;
+    } catch (const std::exception &e) {
+      log(LOG_ERROR, "Error: retrieve_packet_from_encoder: {}", e.what());
+      return false;
+    }
+  };
+  const auto send = [&]() noexcept {
+    try {
+      send_frame_to_encoder(surface_type);
+      return true;
+    } catch (const std::exception &e) {
+      log(LOG_ERROR, "Error: send_frame_to_encoder: {}", e.what());
+      return false;
+    }
+  };
   try {
-    received_packet = retrieve_packet_from_encoder(packet);
+    apply_pending_update();
   } catch (const std::exception &e) {
-    log(LOG_ERROR, "Error: retrieve_packet_from_encoder: {}", e.what());
-    return false;
+    log(LOG_ERROR, "Error: apply_pending_update: {}", e.what());
+  }
+  bool success{false};
+  switch (options.output_mode) {
+  case OutputMode::Poll:
+    success = retrieve() && send();
+    break;
+  case OutputMode::DrainThread:
+  case OutputMode::BoundedWait:
+    success = send() && retrieve();
+    break;
   }
   try {
-    send_frame_to_encoder(surface_type);
+    run_bitrate_controller();
+    run_overload_governor();
+    maybe_report_stats();
+  } catch (const std::exception &e) {
+    log(LOG_ERROR, "Error: encode: {}", e.what());
+  }
+  return success;
+}
+
+bool Encoder::update(obs_data &data) noexcept {
+  try {
+    auto next{snapshot(data)};
+    apply_obs_bitrate(*applied_settings, *next);
+    std::vector<const Setting *> changed;
+    for (const auto &setting : details.settings) {
+      if (!setting->changed(*applied_settings, *next)) {
+        continue;
+      }
+      if (setting->live()) {
+        changed.push_back(setting.get());
+      } else {
+        log(LOG_WARNING, "{} changes when the encoder is restarted",
+            setting->obs_name());
+      }
+    }
+    // Options are only read when the encoder is created.
+    for (const auto *const option : Options::settings) {
+      if (option->changed(*applied_settings, *next)) {
+        log(LOG_INFO, "option {} changes when the encoder is recreated",
+            option->obs_name());
+      }
+    }
+    if (!changed.empty()) {
+      std::scoped_lock lock{update_mutex};
+      // Settings from an update that encode has not picked up yet are still
+      // changed. Their latest values are in next too.
+      for (const auto *const setting : changed) {
+        if (std::ranges::find(pending_settings, setting) ==
+            pending_settings.end()) {
+          pending_settings.push_back(setting);
+        }
+      }
+      pending_update = snapshot(*next);
+      update_pending.store(true, std::memory_order_release);
+    }
+    applied_settings = std::move(next);
+    return true;
   } catch (const std::exception &e) {
-    log(LOG_ERROR, "Error: send_frame_to_encoder: {}", e.what());
+    log(LOG_ERROR, "Error: update: {}", e.what());
     return false;
   }
-  return true;
+}
+
+void Encoder::apply_pending_update() {
+  if (!update_pending.load(std::memory_order_acquire)) {
+    return;
+  }
+  ObsData data{nullptr, obs_data_release};
+  std::vector<const Setting *> settings;
+  {
+    std::scoped_lock lock{update_mutex};
+    data = std::move(pending_update);
+    settings.swap(pending_settings);
+    update_pending.store(false, std::memory_order_relaxed);
+  }
+  for (const auto *const setting : settings) {
+    setting->amf_property(*data, *amf_encoder);
+  }
+  // Only the changed settings are checked so that unrelated clamps are not
+  // logged again. Live settings are never rejected.
+  std::vector<SettingLimit> limits;
+  for (const auto &limit : details.setting_limits(caps)) {
+    const auto matches = [&](const Setting *setting) {
+      return std::string_view{setting->obs_name()} == limit.setting.get();
+    };
+    if (limit.clamp && std::ranges::any_of(settings, matches)) {
+      limits.push_back(limit);
+    }
+  }
+  enforce_setting_limits(*data, *amf_encoder, limits);
+  // The user's bitrate wins over the controller's until it adapts again.
+  if (bitrate_controller) {
+    bitrate_controller->set_target(
+        get_property<int64_t>(*amf_encoder, details.target_bitrate_property));
+  }
+}
+
+void Encoder::start_bitrate_controller() {
+  const auto target{
+      get_property<int64_t>(*amf_encoder, details.target_bitrate_property)};
+  const auto peak{
+      get_property<int64_t>(*amf_encoder, details.peak_bitrate_property)};
+  peak_bitrate_ratio =
+      target > 0 ? std::max(1.0, static_cast<double>(peak) / target) : 1;
+  auto max{options.adaptive_bitrate_max > 0 ? options.adaptive_bitrate_max
+                                            : target};
+  if (caps.max_bitrate > 0) {
+    max = std::min<int64_t>(max, caps.max_bitrate / peak_bitrate_ratio);
+  }
+  const auto min{std::min(options.adaptive_bitrate_min, max)};
+  const auto window_frames{
+      std::chrono::duration<double>(options.adaptive_bitrate_window).count() *
+      frame_rate};
+  bitrate_controller.emplace(
+      BitrateControllerConfig{
+          .min_bitrate = min,
+          .max_bitrate = max,
+          .increase = options.adaptive_bitrate_increase,
+          .decrease_factor = options.adaptive_bitrate_decrease,
+          .window_frames =
+              static_cast<uint32_t>(std::max(1.0, std::round(window_frames))),
+          .input_full_threshold = options.adaptive_bitrate_input_full_threshold,
+          .overshoot_threshold = options.adaptive_bitrate_overshoot_threshold,
+      },
+      target, frame_rate);
+  log(LOG_INFO, "adaptive bitrate between {} and {} kbps", min / 1000,
+      max / 1000);
+}
+
+void Encoder::run_bitrate_controller() {
+  if (!bitrate_controller) {
+    return;
+  }
+  const auto target{
+      bitrate_controller->observe(stats.input_full_frames, stats.bytes_out)};
+  if (!target) {
+    return;
+  }
+  set_property(*amf_encoder, details.target_bitrate_property, *target);
+  set_property(*amf_encoder, details.peak_bitrate_property,
+               static_cast<int64_t>(*target * peak_bitrate_ratio));
+  ++stats.bitrate_changes;
+  log_async(LOG_DEBUG, "adaptive bitrate target {} kbps", *target / 1000);
+}
+
+void Encoder::start_overload_governor() {
+  const auto &properties{details.quality_properties};
+  QualityLevel level{
+      .preset = get_property<int64_t>(*amf_encoder, properties.preset),
+      .motion_half_pixel =
+          get_property<bool>(*amf_encoder, properties.motion_half_pixel),
+      .motion_quarter_pixel =
+          get_property<bool>(*amf_encoder, properties.motion_quarter_pixel),
+  };
+  // Faster presets first because they save the most, then motion estimation
+  // precision from the finest. The AMF headers list some of these as static.
+  // Levels that would change a property the encoder does not take anymore are
+  // left out because they would not reduce the load. No frame was submitted
+  // yet so probing does not affect the output.
+  const auto skip = [](czstring property) {
+    log(LOG_INFO, "overload governor: {} cannot change after init, skipped",
+        property);
+  };
+  quality_levels = {level};
+  const auto &presets{properties.presets};
+  const auto current{std::ranges::find(presets, level.preset)};
+  if (current != presets.end() && current + 1 != presets.end()) {
+    if (changes_after_init(*amf_encoder, properties.preset, level.preset,
+                           *(current + 1))) {
+      for (auto faster{current + 1}; faster != presets.end(); ++faster) {
+        level.preset = *faster;
+        quality_levels.push_back(level);
+      }
+    } else {
+      skip("preset");
+    }
+  }
+  if (level.motion_quarter_pixel) {
+    if (changes_after_init(*amf_encoder, properties.motion_quarter_pixel, true,
+                           false)) {
+      level.motion_quarter_pixel = false;
+      quality_levels.push_back(level);
+    } else {
+      skip("quarter pixel motion estimation");
+    }
+  }
+  if (level.motion_half_pixel) {
+    if (changes_after_init(*amf_encoder, properties.motion_half_pixel, true,
+                           false)) {
+      level.motion_half_pixel = false;
+      quality_levels.push_back(level);
+    } else {
+      skip("half pixel motion estimation");
+    }
+  }
+  if (quality_levels.size() == 1) {
+    log(LOG_INFO, "overload governor: no lower quality level to switch to");
+    return;
+  }
+  const auto window_frames{
+      std::chrono::duration<double>(options.overload_window).count() *
+      frame_rate};
+  overload_governor.emplace(
+      OverloadGovernorConfig{
+          .window_frames =
+              static_cast<uint32_t>(std::max(1.0, std::round(window_frames))),
+          .input_full_threshold = options.overload_input_full_threshold,
+          .latency_threshold = options.overload_latency_threshold,
+          .queue_threshold = options.overload_queue_threshold,
+          .recover_windows = options.overload_recover_windows,
+      },
+      static_cast<uint32_t>(quality_levels.size() - 1));
+}
+
+void Encoder::run_overload_governor() {
+  const auto latency{std::exchange(frame_latency, std::nullopt)};
+  if (!overload_governor) {
+    return;
+  }
+  const auto previous{overload_governor->current_level()};
+  const auto next{overload_governor->observe(stats.input_full_frames, latency,
+                                             pending_input.size())};
+  if (!next) {
+    return;
+  }
+  const auto &from{quality_levels[previous]};
+  const auto &to{quality_levels[*next]};
+  log(LOG_INFO,
+      "overload governor: quality level {} -> {}, preset {} motion half pixel "
+      "{} quarter pixel {}",
+      previous, *next, to.preset, to.motion_half_pixel,
+      to.motion_quarter_pixel);
+  // Only properties that took a new value after init are part of the levels.
+  const auto &properties{details.quality_properties};
+  if (from.preset != to.preset) {
+    set_property_fallible(*amf_encoder, properties.preset, to.preset);
+  }
+  if (from.motion_half_pixel != to.motion_half_pixel) {
+    set_property_fallible(*amf_encoder, properties.motion_half_pixel,
+                          to.motion_half_pixel);
+  }
+  if (from.motion_quarter_pixel != to.motion_quarter_pixel) {
+    set_property_fallible(*amf_encoder, properties.motion_quarter_pixel,
+                          to.motion_quarter_pixel);
+  }
+  ++stats.quality_level_changes;
 }
 
 void Encoder::send_frame_to_encoder(SurfaceType surface_type) {
   amf::AMFSurfacePtr surface;
   uint64_t pts;
   if (auto s = std::get_if<CpuSurface>(&surface_type)) {
+    const auto copy_start{std::chrono::steady_clock::now()};
     surface = obs_frame_to_surface(*(s->frame));
+    stats.copy_time += std::chrono::steady_clock::now() - copy_start;
     pts = s->frame->pts;
   } else if (auto s = std::get_if<GpuSurface>(&surface_type)) {
     surface = obs_texture_to_surface(s->handle, s->lock_key, *(s->next_key));
@@ -267,69 +759,254 @@ void Encoder::send_frame_to_encoder(SurfaceType surface_type) {
   } else {
     ASSERT_(false);
   }
+  if (!surface) {
+    log_async(LOG_DEBUG, "send_frame_to_encoder: skipped");
+    return;
+  }
   set_property(*surface, pts_property, pts);
-  const auto result = amf_encoder->SubmitInput(surface);
+
+  // Keep frames in order: the new frame can only be submitted directly if
+  // nothing is waiting anymore.
+  submit_pending_input();
+  bool found_input_full{false};
+  if (pending_input.empty()) {
+    if (submit_to_encoder(*surface, static_cast<int64_t>(pts))) {
+      return;
+    }
+    found_input_full = true;
+    ++stats.input_full_frames;
+  }
+  if (pending_input.size() >= options.pending_input_capacity &&
+      !drop_pending_input()) {
+    return;
+  }
+  pending_input.push_back(
+      {surface, static_cast<int64_t>(pts), found_input_full});
+  stats.pending_input_high_water_mark =
+      std::max(stats.pending_input_high_water_mark, pending_input.size());
+}
+
+bool Encoder::submit_to_encoder(amf::AMFSurface &surface, int64_t pts) {
+  if (telemetry) {
+    // Feedback is requested per frame. Not logged because it is every frame.
+    const auto &properties{details.telemetry_properties};
+    surface.SetProperty(properties.statistics_feedback, true);
+    surface.SetProperty(properties.psnr_feedback, options.telemetry_quality);
+    surface.SetProperty(properties.ssim_feedback, options.telemetry_quality);
+  }
+  const auto result = amf_encoder->SubmitInput(&surface);
   switch (result) {
   case AMF_OK:
     break;
   case AMF_NEED_MORE_INPUT:
-    log(LOG_DEBUG, "send_frame_to_encoder: need more input");
+    log_async(LOG_DEBUG, "send_frame_to_encoder: need more input");
     break;
   case AMF_INPUT_FULL:
-    // This can happen on overloaded systems. We can't do anything except drop
-    // the frame.
-    log(LOG_DEBUG, "send_frame_to_encoder: input full");
-    log(LOG_WARNING, "dropping frame because encoder is overloaded");
-    break;
+    // This can happen on overloaded systems. The frame is held back and
+    // retried before the next one.
+    log_async(LOG_DEBUG, "send_frame_to_encoder: input full");
+    ++stats.input_full;
+    return false;
   default:
     throw std::runtime_error(fmt::format("SubmitInput: {}", result));
   }
+  dts_generator.submitted(pts);
+  latency_tracker.submitted(pts, std::chrono::steady_clock::now());
+  ++stats.frames_submitted;
+  return true;
+}
+
+void Encoder::submit_pending_input() {
+  while (!pending_input.empty()) {
+    auto &front{pending_input.front()};
+    if (!submit_to_encoder(*front.surface, front.pts)) {
+      if (!front.found_input_full) {
+        front.found_input_full = true;
+        ++stats.input_full_frames;
+      }
+      return;
+    }
+    pending_input.pop_front();
+  }
+}
+
+bool Encoder::drop_pending_input() {
+  log(LOG_WARNING, "dropping frame because encoder is overloaded");
+  ++stats.dropped_frames;
+  // Interior needs a frame between the oldest and the new one.
+  if (pending_input.empty() || options.drop_policy == DropPolicy::Newest ||
+      (options.drop_policy == DropPolicy::Interior &&
+       pending_input.size() < 2)) {
+    return false;
+  }
+  switch (options.drop_policy) {
+  case DropPolicy::Oldest:
+    pending_input.pop_front();
+    break;
+  case DropPolicy::Interior:
+    pending_input.erase(pending_input.begin() +
+                        static_cast<ptrdiff_t>(pending_input.size() / 2));
+    break;
+  case DropPolicy::Newest:
+    break;
+  }
+  return true;
 }
 
 amf::AMFSurfacePtr Encoder::obs_frame_to_surface(const encoder_frame &frame) {
+  if (options.zero_copy) {
+    if (!host_frame_wrapper) {
+      host_frame_wrapper.emplace(shared_device->amf_context, surface_format,
+                                 width, height);
+    }
+    if (auto surface = host_frame_wrapper->upload(frame)) {
+      ++stats.zero_copy_frames;
+      return surface;
+    }
+  }
+  ++stats.copied_frames;
   amf::AMFSurfacePtr surface;
+  if (options.host_surface_pool_size > 0) {
+    if (!host_surface_pool) {
+      host_surface_pool.emplace(shared_device->amf_context, surface_format,
+                                width, height, options.host_surface_pool_size,
+                                options.host_surface_pool_wait);
+    }
+    surface = host_surface_pool->acquire();
+  }
   // Need host memory so that we can write into it.
-  if (amf_context->AllocSurface(amf::AMF_MEMORY_HOST, surface_format, width,
-                                height, &surface) != AMF_OK) {
+  if (!surface && shared_device->amf_context->AllocSurface(
+                      amf::AMF_MEMORY_HOST, surface_format, width, height,
+                      &surface) != AMF_OK) {
     throw std::runtime_error("context->AllocSurface");
   }
-  copy_obs_frame_to_amf_surface(frame, *surface);
+  copy_obs_frame_to_amf_surface(frame, *surface,
+                                copy_pool ? &*copy_pool : nullptr,
+                                options.parallel_copy_threshold);
   return surface;
 }
 
 amf::AMFSurfacePtr Encoder::obs_texture_to_surface(uint32_t handle,
                                                    uint64_t lock_key,
                                                    uint64_t &next_key) {
-  ASSERT_(texture_encoder);
+  if (!texture_encoder) {
+    texture_encoder.emplace(shared_device->amf_context,
+                            shared_device->d11_device,
+                            shared_device->d11_context, width, height,
+                            surface_format,
+                            options.shared_texture_cache_size,
+                            texture_ring_size, options.texture_ring_wait,
+                            options.texture_acquire_timeout,
+                            options.texture_acquire_timeout_action ==
+                                AcquireTimeoutAction::Repeat);
+  }
   return texture_encoder->texture_to_surface(handle, lock_key, next_key);
 }
 
 // Returns whether a packet was received.
 bool Encoder::retrieve_packet_from_encoder(encoder_packet &packet) {
+  amf::AMFDataPtr data;
+  switch (options.output_mode) {
+  case OutputMode::Poll:
+    data = query_output();
+    break;
+  case OutputMode::DrainThread:
+    ASSERT_(output_drain);
+    data = output_drain->pop();
+    break;
+  case OutputMode::BoundedWait:
+    data = wait_for_output();
+    break;
+  }
+  if (!data) {
+    log_async(LOG_DEBUG, "no data");
+    return false;
+  }
+  output_to_packet(*data, packet);
+  return true;
+}
+
+amf::AMFDataPtr Encoder::query_output() {
   amf::AMFDataPtr data;
   const auto result = amf_encoder->QueryOutput(&data);
   if (result == AMF_REPEAT) {
-    log(LOG_DEBUG, "repeat");
-    return false;
+    log_async(LOG_DEBUG, "repeat");
+    ++stats.repeats;
+    return nullptr;
   } else if (result != AMF_OK) {
     throw std::runtime_error(fmt::format("QueryOutput: {}", result));
   }
+  return data;
+}
+
+amf::AMFDataPtr Encoder::wait_for_output() {
+  ++stats.bounded_waits;
+  amf::AMFDataPtr data;
+  if (query_timeout_supported) {
+    // Blocks for up to the budget by itself.
+    data = query_output();
+  } else {
+    const auto deadline{std::chrono::steady_clock::now() +
+                        options.output_wait_budget};
+    for (size_t attempt{0};; ++attempt) {
+      data = query_output();
+      if (data || std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      // Spin first because the packet is likely close. Then give the CPU to
+      // other threads like the encoder's own.
+      if (attempt >= bounded_wait_spins) {
+        std::this_thread::yield();
+      }
+    }
+  }
   if (!data) {
-    log(LOG_DEBUG, "no data");
-    return false;
+    ++stats.bounded_wait_timeouts;
   }
-  amf::AMFBufferPtr buffer{data};
+  return data;
+}
+
+void Encoder::output_to_packet(amf::AMFData &data, encoder_packet &packet) {
+  amf::AMFBufferPtr buffer{&data};
 
   const auto size = buffer->GetSize();
-  packet_buffer.resize(size);
-  std::memcpy(packet_buffer.data(), buffer->GetNative(), size);
-  packet.data = packet_buffer.data();
+  switch (options.packet_output) {
+  case PacketOutput::Retain:
+    // Releases the previous packet which OBS is done with.
+    retained_packet = buffer;
+    packet.data = static_cast<uint8_t *>(buffer->GetNative());
+    break;
+  case PacketOutput::Copy:
+    if (size > packet_buffer_capacity) {
+      packet_buffer = std::make_unique_for_overwrite<uint8_t[]>(size);
+      packet_buffer_capacity = size;
+    }
+    std::memcpy(packet_buffer.get(), buffer->GetNative(), size);
+    packet.data = packet_buffer.get();
+    break;
+  }
   packet.size = size;
+  if (options.strip_filler_data) {
+    // Both packet outputs point at memory only we and OBS read.
+    packet.size = strip_filler_data(details.codec, {packet.data, size});
+    stats.filler_bytes_stripped += size - packet.size;
+  }
 
   packet.pts = get_property<int64_t>(*buffer, pts_property);
-  // TODO: What is the correct DTS? The PTS of the start of the current GOP? But
-  // that would only apply for "closed GOPS" with IDR frames.
-  packet.dts = packet.pts;
+  const auto violations{dts_generator.violation_count()};
+  packet.dts = dts_generator.next(packet.pts);
+  if (dts_generator.violation_count() != violations) {
+    log_async(LOG_WARNING, "invalid dts for pts {}, repaired to {}",
+              packet.pts, packet.dts);
+  }
+
+  ++stats.packets;
+  stats.bytes_out += size;
+  if (const auto latency{latency_tracker.output(
+          packet.pts, std::chrono::steady_clock::now())}) {
+    stats.latency.record(*latency);
+    frame_latency = *latency;
+  }
 
   // packet.timebase_* is not set because it is not set by other encoders
   // either and seems to be initialized before the packet is sent to us
@@ -340,10 +1017,147 @@ bool Encoder::retrieve_packet_from_encoder(encoder_packet &packet) {
 
   const auto packet_info = get_packet_info(*buffer);
   packet.keyframe = packet_info.is_key_frame;
+  if (packet.keyframe) {
+    refresh_extra_data({packet.data, packet.size});
+  }
+  // Lets OBS drop the least important frames first when the output is
+  // congested.
+  const auto priority{
+      classify_packet(details.codec, {packet.data, packet.size})};
+  const auto fallback{packet.keyframe ? NalPriority::Highest
+                                      : NalPriority::High};
+  packet.priority = obs_nal_priority(priority ? priority->priority : fallback);
+  packet.drop_priority =
+      obs_nal_priority(priority ? priority->drop_priority : fallback);
 
-  log(LOG_DEBUG, "packet pts {} keyframe {} size {}", packet.pts,
-      packet.keyframe, packet.size);
-  return true;
+  if (telemetry) {
+    record_telemetry(*buffer, packet);
+  }
+
+  log_async(LOG_DEBUG, "packet pts {} keyframe {} size {}", packet.pts,
+            packet.keyframe, packet.size);
+}
+
+void Encoder::start_telemetry() {
+  telemetry.emplace(telemetry_capacity);
+  if (options.telemetry_file.empty()) {
+    return;
+  }
+  std::error_code error;
+  const auto exists{std::filesystem::file_size(options.telemetry_file, error) >
+                    0};
+  try {
+    telemetry_file.emplace(options.telemetry_file);
+  } catch (const std::exception &e) {
+    log(LOG_WARNING, "telemetry file: {}", e.what());
+    return;
+  }
+  if (error || !exists) {
+    telemetry_file->write(telemetry_csv_header());
+  }
 }
 
-std::span<uint8_t> Encoder::get_extra_data() noexcept { return extra_data; }
+void Encoder::record_telemetry(amf::AMFPropertyStorage &output,
+                               const encoder_packet &packet) {
+  const auto &properties{details.telemetry_properties};
+  auto &record{telemetry->push()};
+  record = {
+      .pts = packet.pts,
+      .bytes = packet.size,
+      .keyframe = packet.keyframe,
+      .frame_qp = optional_int(output, properties.frame_qp),
+      .average_qp = optional_int(output, properties.average_qp),
+      .min_qp = optional_int(output, properties.min_qp),
+      .max_qp = optional_int(output, properties.max_qp),
+      .intra_pixels = optional_int(output, properties.intra_pixels),
+      .inter_pixels = optional_int(output, properties.inter_pixels),
+      .skip_pixels = optional_int(output, properties.skip_pixels),
+      .residual_bits = optional_int(output, properties.residual_bits),
+      .motion_bits = optional_int(output, properties.motion_bits),
+      .bits_without_header =
+          optional_int(output, properties.bits_without_header),
+      .psnr = optional_double(output, properties.psnr),
+      .ssim = optional_double(output, properties.ssim),
+  };
+  // Write before unwritten records are overwritten.
+  if (telemetry->total() - telemetry_written >= telemetry->capacity()) {
+    write_telemetry();
+  }
+}
+
+void Encoder::write_telemetry() {
+  const auto total{telemetry->total()};
+  if (!telemetry_file || total == telemetry_written) {
+    telemetry_written = total;
+    return;
+  }
+  std::string lines;
+  for (auto i{telemetry_written}; i < total; ++i) {
+    append_telemetry_csv(lines, telemetry->at(i));
+  }
+  telemetry_file->write(lines);
+  telemetry_written = total;
+}
+
+void Encoder::report_stats() {
+  auto reported{stats};
+  if (output_drain) {
+    reported.repeats += output_drain->repeat_count();
+  }
+  reported.dts_violations = dts_generator.violation_count();
+  EncoderGauges gauges{
+      .pending_input = pending_input.size(),
+      .output_queue = output_drain ? output_drain->queued() : 0,
+      .host_surface_pool = host_surface_pool
+                               ? std::optional{host_surface_pool->stats()}
+                               : std::nullopt,
+      .shared_texture_cache =
+          texture_encoder
+              ? std::optional{texture_encoder->shared_texture_cache_stats()}
+              : std::nullopt,
+      .texture_ring =
+          texture_encoder
+              ? std::optional{texture_encoder->texture_ring_stats()}
+              : std::nullopt,
+      .keyed_mutex =
+          texture_encoder
+              ? std::optional{texture_encoder->take_keyed_mutex_stats()}
+              : std::nullopt,
+      .target_bitrate =
+          bitrate_controller
+              ? std::optional{bitrate_controller->target_bitrate()}
+              : std::nullopt,
+      .quality_level =
+          overload_governor
+              ? std::optional{overload_governor->current_level()}
+              : std::nullopt,
+      .telemetry = telemetry ? std::optional{telemetry->summarize()}
+                             : std::nullopt,
+  };
+  log(LOG_INFO, "{}", format_stats_summary(reported, gauges));
+  if (stats_file) {
+    stats_file->write(format_stats_json(reported, gauges) + '\n');
+  }
+  if (telemetry) {
+    write_telemetry();
+  }
+  // Latency percentiles are per report. Everything else is cumulative.
+  stats.latency.clear();
+}
+
+void Encoder::maybe_report_stats() {
+  if (options.stats_interval.count() == 0) {
+    return;
+  }
+  const auto now{std::chrono::steady_clock::now()};
+  if (now < next_stats_report) {
+    return;
+  }
+  next_stats_report = now + options.stats_interval;
+  report_stats();
+}
+
+std::span<uint8_t> Encoder::get_extra_data() noexcept {
+  std::scoped_lock lock{extra_data_mutex};
+  return extra_data;
+}
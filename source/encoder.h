@@ -1,10 +1,26 @@
 #pragma once
 
-#include "amf.h"
+#include "bitrate_controller.h"
+#include "bitstream.h"
+#include "device_registry.h"
+#include "dts_generator.h"
+#include "encoder_caps.h"
+#include "encoder_stats.h"
+#include "file_writer.h"
 #include "gsl.h"
+#include "host_frame_wrapper.h"
+#include "host_surface_pool.h"
+#include "options.h"
+#include "output_drain.h"
+#include "overload_governor.h"
+#include "settings.h"
+#include "telemetry.h"
 #include "texture_encoder.h"
+#include "util.h"
+#include "worker_pool.h"
 
 #include <AMF/components/Component.h>
+#include <AMF/core/Buffer.h>
 #include <AMF/core/Context.h>
 #include <AMF/core/Plane.h>
 #include <AMF/core/Surface.h>
@@ -13,7 +29,13 @@
 #include <atlbase.h>
 #include <d3d11.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <variant>
@@ -27,12 +49,54 @@ struct ColorProperties {
   not_null<cwzstring> primaries;
 };
 
+// Properties the overload governor lowers.
+struct QualityProperties {
+  not_null<cwzstring> preset;
+  // Preset values from slowest to fastest.
+  std::array<int64_t, 3> presets;
+  not_null<cwzstring> motion_half_pixel;
+  not_null<cwzstring> motion_quarter_pixel;
+};
+
+// Per frame feedback for telemetry.
+struct TelemetryProperties {
+  // Requested on each input surface.
+  not_null<cwzstring> statistics_feedback;
+  not_null<cwzstring> psnr_feedback;
+  not_null<cwzstring> ssim_feedback;
+  // Reported on the output buffer.
+  not_null<cwzstring> frame_qp;
+  not_null<cwzstring> average_qp;
+  not_null<cwzstring> min_qp;
+  not_null<cwzstring> max_qp;
+  not_null<cwzstring> intra_pixels;
+  not_null<cwzstring> inter_pixels;
+  not_null<cwzstring> skip_pixels;
+  not_null<cwzstring> residual_bits;
+  not_null<cwzstring> motion_bits;
+  not_null<cwzstring> bits_without_header;
+  not_null<cwzstring> psnr;
+  not_null<cwzstring> ssim;
+};
+
 struct EncoderDetails {
   not_null<cwzstring> amf_encoder_name;
+  Codec codec;
   not_null<cwzstring> extra_data_property;
   not_null<cwzstring> frame_rate_property;
+  not_null<cwzstring> query_timeout_property;
+  // Capability telling whether query_timeout_property is supported.
+  not_null<cwzstring> query_timeout_support_cap;
+  not_null<cwzstring> target_bitrate_property;
+  not_null<cwzstring> peak_bitrate_property;
   ColorProperties input_color_properties;
   ColorProperties output_color_properties;
+  QualityProperties quality_properties;
+  TelemetryProperties telemetry_properties;
+  std::span<const std::unique_ptr<const Setting>> settings;
+  not_null<const CapsProperties *> caps_properties;
+  // How the caps restrict the settings.
+  std::vector<SettingLimit> (*setting_limits)(const EncoderCaps &);
 };
 
 // information extracted from one encoder output packet
@@ -62,37 +126,163 @@ class Encoder {
                                                         obs_data &) = 0;
   virtual void set_color_range(amf::AMFPropertyStorage &, ColorRange) = 0;
   virtual PacketInfo get_packet_info(amf::AMFPropertyStorage &) = 0;
+  // How many frames a packet can be decoded before it is presented. Called
+  // after the encoder has been initialized.
+  virtual int64_t reorder_depth(amf::AMFPropertyStorage &) = 0;
   // ---
 
-  // The same device that OBS is configured with.
-  CComPtr<ID3D11Device> d11_device;
-  CComPtr<ID3D11DeviceContext> d11_context;
-  Amf amf;
-  // Based on d11_device.
-  amf::AMFContextPtr amf_context;
+  // On the same adapter that OBS is configured with. Shared with other
+  // encoders on the adapter. Declared first so that it outlives everything
+  // created from it.
+  std::shared_ptr<SharedDevice> shared_device;
+  // Created on the first CPU frame. Declared before amf_encoder so that the
+  // encoder releases its surfaces before the pool memory is freed.
+  std::optional<HostSurfacePool> host_surface_pool;
+  // Created on the first CPU frame when zero copy is enabled.
+  std::optional<HostFrameWrapper> host_frame_wrapper;
   amf::AMFComponentPtr amf_encoder;
-  // Optional only so that we can delay initialization in constructor.
+  // Created on the first texture frame because OBS falls back to CPU frames
+  // for some formats.
   std::optional<TextureEncoder> texture_encoder;
+  // Only used in OutputMode::DrainThread. Declared after amf_encoder so that
+  // the thread is stopped before the encoder is released.
+  std::optional<OutputDrain> output_drain;
+
+  // A frame the encoder did not accept yet because its input was full.
+  struct PendingInput {
+    amf::AMFSurfacePtr surface;
+    int64_t pts;
+    // Whether it was counted in EncoderStats::input_full_frames.
+    bool found_input_full;
+  };
+  // Submitted in order before any new frame. Declared after the surface
+  // sources so that the surfaces are released first.
+  std::deque<PendingInput> pending_input;
+
+  Options options;
+  // Splits copying CPU frames into surfaces. Only created with more than one
+  // copy thread.
+  std::optional<WorkerPool> copy_pool;
+
+  // Whether QueryOutput blocks until output is ready or the query timeout
+  // passes. Only set for OutputMode::BoundedWait and OutputMode::DrainThread.
+  // Otherwise they poll.
+  bool query_timeout_supported{false};
+
+  EncoderStats stats;
+  LatencyTracker latency_tracker;
+  std::chrono::steady_clock::time_point next_stats_report;
+  // Set when Options::stats_file is set and could be opened.
+  std::optional<FileWriter> stats_file;
+  // Set when Options::telemetry is on.
+  std::optional<TelemetryRing> telemetry;
+  // Set when Options::telemetry_file is set and could be opened.
+  std::optional<FileWriter> telemetry_file;
+  // Records before this were written to telemetry_file.
+  uint64_t telemetry_written{0};
+
+  EncoderCaps caps;
+  // The settings as of construction and the last update. Updates are diffed
+  // against them.
+  ObsData applied_settings{nullptr, obs_data_release};
+  // OBS calls update on another thread than encode. Changes are handed over
+  // and applied between frames. Guarded by update_mutex.
+  std::mutex update_mutex;
+  ObsData pending_update{nullptr, obs_data_release};
+  std::vector<const Setting *> pending_settings;
+  std::atomic<bool> update_pending{false};
+
+  // Only with Options::adaptive_bitrate.
+  std::optional<BitrateController> bitrate_controller;
+  // The controller keeps the configured ratio of peak to target bitrate.
+  double peak_bitrate_ratio{1};
+
+  struct QualityLevel {
+    int64_t preset;
+    bool motion_half_pixel;
+    bool motion_quarter_pixel;
+  };
+  // Index is the governor's level. Level 0 is the user's configuration.
+  std::vector<QualityLevel> quality_levels;
+  // Only with Options::overload_governor.
+  std::optional<OverloadGovernor> overload_governor;
+  // Latency of the packet received in the current call to encode.
+  std::optional<std::chrono::microseconds> frame_latency;
+
+  DtsGenerator dts_generator;
+  // Textures preallocated by texture_encoder.
+  size_t texture_ring_size{0};
 
   uint32_t width;
   uint32_t height;
+  double frame_rate{0};
+  // In PTS ticks. OBS advances the PTS of every frame by this.
+  int64_t frame_duration{1};
   amf::AMF_SURFACE_FORMAT surface_format;
+  // Parameter sets the extra data was made from, normalized by
+  // find_parameter_sets.
+  std::vector<uint8_t> parameter_sets;
+  // Read by OBS from other threads while a keyframe may replace it.
+  std::mutex extra_data_mutex;
   std::vector<uint8_t> extra_data;
+  // Replaced extra data. OBS may still hold pointers into it so it lives as
+  // long as the encoder. Parameter sets rarely change so this stays small.
+  std::vector<std::vector<uint8_t>> retired_extra_data;
 
-  // When returning a packet we need to give it a data pointer. That data is
-  // stored here. It is not specified how long that pointer has to stay alive.
-  // We assume it must live until the next call to encode.
-  std::vector<uint8_t> packet_buffer;
+  // When returning a packet we need to give it a data pointer. It is not
+  // specified how long that pointer has to stay alive. We assume it must live
+  // until the next call to encode. OBS copies the packet before then so one
+  // packet is all we need to keep.
+  // PacketOutput::Retain points into this buffer.
+  amf::AMFBufferPtr retained_packet;
+  // PacketOutput::Copy copies into this. It only grows and is not zero
+  // initialized.
+  std::unique_ptr<uint8_t[]> packet_buffer;
+  size_t packet_buffer_capacity{0};
 
-  void initialize_dx11();
   void apply_settings(obs_data &a, obs_encoder &);
+  // Apply the settings handed over by update.
+  void apply_pending_update();
+  void start_bitrate_controller();
+  // Feed the controller one frame's signals and apply its decision.
+  void run_bitrate_controller();
+  void start_overload_governor();
+  void run_overload_governor();
   void set_extra_data();
+  // Replace the extra data when a keyframe carries different parameter sets.
+  void refresh_extra_data(std::span<const uint8_t> packet);
+  void publish_extra_data(std::vector<uint8_t> found);
+  // Make QueryOutput block for up to timeout if the encoder supports it.
+  void configure_query_timeout(std::chrono::milliseconds timeout);
   void send_frame_to_encoder(SurfaceType);
+  // Returns false if the encoder's input is full.
+  bool submit_to_encoder(amf::AMFSurface &, int64_t pts);
+  // Submit pending input until the encoder's input is full.
+  void submit_pending_input();
+  // Make room in pending_input according to the drop policy. Returns false if
+  // the new frame is the one to drop.
+  bool drop_pending_input();
   // Returns whether a packet was received.
   bool retrieve_packet_from_encoder(encoder_packet &);
+  // Query the encoder once. Returns nullptr if there is no output yet.
+  amf::AMFDataPtr query_output();
+  // Query the encoder until there is output or the wait budget is spent.
+  amf::AMFDataPtr wait_for_output();
+  // Fill an OBS packet from one encoder output.
+  void output_to_packet(amf::AMFData &, encoder_packet &);
+  void start_telemetry();
+  void record_telemetry(amf::AMFPropertyStorage &output,
+                        const encoder_packet &);
+  // Append the records not yet written to telemetry_file.
+  void write_telemetry();
+  // Log stats and append them to the stats file. Resets the latency
+  // histogram.
+  void report_stats();
+  // report_stats if the stats interval has passed.
+  void maybe_report_stats();
   // surface is created on CPU
   amf::AMFSurfacePtr obs_frame_to_surface(const encoder_frame &);
-  // surface is created on GPU
+  // surface is created on GPU. nullptr if the frame was skipped.
   amf::AMFSurfacePtr obs_texture_to_surface(uint32_t handle, uint64_t lock_key,
                                             uint64_t &next_key);
 
@@ -104,7 +294,11 @@ public:
   // Cannot call virtual functions of derived in constructor so sadly need this
   // workaround.
   void finish_construction(obs_data &, obs_encoder &);
-  virtual ~Encoder() noexcept = default;
+  virtual ~Encoder() noexcept;
   bool encode(SurfaceType, encoder_packet &, bool &received_packet) noexcept;
+  // Changes the settings that the encoder accepts while running. Changes to
+  // other settings and to Options are logged and take effect when the encoder
+  // is created again.
+  bool update(obs_data &) noexcept;
   std::span<uint8_t> get_extra_data() noexcept;
 };
@@ -40,11 +40,79 @@ PacketInfo EncoderAvc::get_packet_info(amf::AMFPropertyStorage &output) {
   throw std::runtime_error(fmt::format("unknown packet type {}", packet_type));
 }
 
+int64_t EncoderAvc::reorder_depth(amf::AMFPropertyStorage &encoder) {
+  // Read back instead of using the settings because the encoder might not
+  // support B-frames and then ignores them.
+  int64_t pattern{0};
+  if (encoder.GetProperty(AMF_VIDEO_ENCODER_B_PIC_PATTERN, &pattern) !=
+      AMF_OK) {
+    return 0;
+  }
+  if (pattern == 0) {
+    return 0;
+  }
+  // Without references B-frames are decoded right after the following P-frame
+  // so they lag by one. Referenced B-frames form a pyramid in which the
+  // unreferenced ones lag by one more.
+  bool b_reference{false};
+  encoder.GetProperty(AMF_VIDEO_ENCODER_B_REFERENCE_ENABLE, &b_reference);
+  return b_reference && pattern >= 2 ? 2 : 1;
+}
+
+namespace {
+
+// The constrained profiles are subsets of the profiles they are based on.
+int64_t profile_rank(int64_t profile) {
+  switch (profile) {
+  case AMF_VIDEO_ENCODER_PROFILE_CONSTRAINED_BASELINE:
+    return AMF_VIDEO_ENCODER_PROFILE_BASELINE;
+  case AMF_VIDEO_ENCODER_PROFILE_CONSTRAINED_HIGH:
+    return AMF_VIDEO_ENCODER_PROFILE_HIGH;
+  }
+  return profile;
+}
+
+} // namespace
+
+std::vector<SettingLimit> EncoderAvc::setting_limits(const EncoderCaps &caps) {
+  std::vector<SettingLimit> limits;
+  if (caps.max_bitrate > 0) {
+    limits.push_back({"target bit rate", AMF_VIDEO_ENCODER_TARGET_BITRATE,
+                      caps.max_bitrate, true});
+    limits.push_back({"peak bit rate", AMF_VIDEO_ENCODER_PEAK_BITRATE,
+                      caps.max_bitrate, true});
+  }
+  if (caps.max_reference_frames > 0) {
+    limits.push_back({"max num reframes", AMF_VIDEO_ENCODER_MAX_NUM_REFRAMES,
+                      caps.max_reference_frames, true});
+  }
+  if (!caps.b_frames) {
+    limits.push_back(
+        {"b pic pattern", AMF_VIDEO_ENCODER_B_PIC_PATTERN, 0, true});
+  }
+  if (caps.max_profile > 0) {
+    limits.push_back({"profile", AMF_VIDEO_ENCODER_PROFILE, caps.max_profile,
+                      false, profile_rank});
+  }
+  // The level setting is called tier.
+  if (caps.max_level > 0) {
+    limits.push_back({"tier", AMF_VIDEO_ENCODER_PROFILE_LEVEL, caps.max_level,
+                      false});
+  }
+  return limits;
+}
+
 EncoderAvc::EncoderAvc()
     : Encoder({
           .amf_encoder_name = AMFVideoEncoderVCE_AVC,
+          .codec = Codec::Avc,
           .extra_data_property = AMF_VIDEO_ENCODER_EXTRADATA,
           .frame_rate_property = AMF_VIDEO_ENCODER_FRAMERATE,
+          .query_timeout_property = AMF_VIDEO_ENCODER_QUERY_TIMEOUT,
+          .query_timeout_support_cap =
+              AMF_VIDEO_ENCODER_CAPS_QUERY_TIMEOUT_SUPPORT,
+          .target_bitrate_property = AMF_VIDEO_ENCODER_TARGET_BITRATE,
+          .peak_bitrate_property = AMF_VIDEO_ENCODER_PEAK_BITRATE,
           .input_color_properties =
               {.profile = AMF_VIDEO_ENCODER_INPUT_COLOR_PROFILE,
                .transfer_characteristic =
@@ -55,6 +123,33 @@ EncoderAvc::EncoderAvc()
                .transfer_characteristic =
                    AMF_VIDEO_ENCODER_OUTPUT_TRANSFER_CHARACTERISTIC,
                .primaries = AMF_VIDEO_ENCODER_OUTPUT_COLOR_PRIMARIES},
+          .quality_properties =
+              {.preset = AMF_VIDEO_ENCODER_QUALITY_PRESET,
+               .presets = {AMF_VIDEO_ENCODER_QUALITY_PRESET_QUALITY,
+                           AMF_VIDEO_ENCODER_QUALITY_PRESET_BALANCED,
+                           AMF_VIDEO_ENCODER_QUALITY_PRESET_SPEED},
+               .motion_half_pixel = AMF_VIDEO_ENCODER_MOTION_HALF_PIXEL,
+               .motion_quarter_pixel = AMF_VIDEO_ENCODER_MOTION_QUARTERPIXEL},
+          .telemetry_properties =
+              {.statistics_feedback = AMF_VIDEO_ENCODER_STATISTICS_FEEDBACK,
+               .psnr_feedback = AMF_VIDEO_ENCODER_PSNR_FEEDBACK,
+               .ssim_feedback = AMF_VIDEO_ENCODER_SSIM_FEEDBACK,
+               .frame_qp = AMF_VIDEO_ENCODER_STATISTIC_FRAME_QP,
+               .average_qp = AMF_VIDEO_ENCODER_STATISTIC_AVERAGE_QP,
+               .min_qp = AMF_VIDEO_ENCODER_STATISTIC_MIN_QP,
+               .max_qp = AMF_VIDEO_ENCODER_STATISTIC_MAX_QP,
+               .intra_pixels = AMF_VIDEO_ENCODER_STATISTIC_PIX_NUM_INTRA,
+               .inter_pixels = AMF_VIDEO_ENCODER_STATISTIC_PIX_NUM_INTER,
+               .skip_pixels = AMF_VIDEO_ENCODER_STATISTIC_PIX_NUM_SKIP,
+               .residual_bits = AMF_VIDEO_ENCODER_STATISTIC_BITCOUNT_RESIDUAL,
+               .motion_bits = AMF_VIDEO_ENCODER_STATISTIC_BITCOUNT_MOTION,
+               .bits_without_header =
+                   AMF_VIDEO_ENCODER_STATISTIC_BITCOUNT_ALL_MINUS_HEADER,
+               .psnr = AMF_VIDEO_ENCODER_STATISTIC_PSNR_ALL,
+               .ssim = AMF_VIDEO_ENCODER_STATISTIC_SSIM_ALL},
+          .settings = settings,
+          .caps_properties = &caps_properties,
+          .setting_limits = setting_limits,
       }) {}
 
 namespace {
@@ -110,29 +205,30 @@ const S settings_[] = {
          {AMF_VIDEO_ENCODER_RATE_CONTROL_METHOD_QUALITY_VBR,
           "Quality Variable Bit Rate"}},
         0}},
+    // The trailing true marks settings that can change while encoding.
     S{new IntSetting{"target bit rate", "Target Bit Rate",
                      AMF_VIDEO_ENCODER_TARGET_BITRATE, 1,
-                     std::numeric_limits<int>::max(), 10000000}},
+                     std::numeric_limits<int>::max(), 10000000, true}},
     S{new IntSetting{"peak bit rate", "Peak Bit Rate",
                      AMF_VIDEO_ENCODER_PEAK_BITRATE, 1,
-                     std::numeric_limits<int>::max(), 30000000}},
+                     std::numeric_limits<int>::max(), 30000000, true}},
     S{new BoolSetting{"skip frame enable", "Skip Frames for Rate Control",
                       AMF_VIDEO_ENCODER_RATE_CONTROL_SKIP_FRAME_ENABLE, false}},
     S{new IntSetting{"min qp i", "Minimum I Frame QP", AMF_VIDEO_ENCODER_MIN_QP,
-                     0, 51, 18}},
+                     0, 51, 18, true}},
     S{new IntSetting{"max qp i", "Maximum I Frame QP", AMF_VIDEO_ENCODER_MAX_QP,
-                     0, 51, 46}},
+                     0, 51, 46, true}},
     S{new IntSetting{"qp i", "CQP: I Frame QP", AMF_VIDEO_ENCODER_QP_I, 0, 51,
-                     26}},
+                     26, true}},
     S{new IntSetting{"qp p", "CQP: P Frame QP", AMF_VIDEO_ENCODER_QP_P, 0, 51,
-                     26}},
+                     26, true}},
     S{new IntSetting{"qp b", "CQP: B Frame QP", AMF_VIDEO_ENCODER_QP_B, 0, 51,
-                     26}},
+                     26, true}},
     S{new IntSetting{"qvbr quality level", "QVBR Quality Level",
-                     AMF_VIDEO_ENCODER_QVBR_QUALITY_LEVEL, 1, 51, 23}},
+                     AMF_VIDEO_ENCODER_QVBR_QUALITY_LEVEL, 1, 51, 23, true}},
     S{new IntSetting{"vbv buffer size", "VBV Buffer Size",
                      AMF_VIDEO_ENCODER_VBV_BUFFER_SIZE, 1,
-                     std::numeric_limits<int>::max(), 20000000}},
+                     std::numeric_limits<int>::max(), 20000000, true}},
     S{new IntSetting{"initial vbv buffer fullness",
                      "Initial VBV Buffer Fullness",
                      AMF_VIDEO_ENCODER_INITIAL_VBV_BUFFER_FULLNESS, 0, 64, 64}},
@@ -149,22 +245,24 @@ const S settings_[] = {
     // Skipping MAX_AU_SIZE because we couldn't find what it means.
     S{new IntSetting{"max num reframes", "Maximum Reference Frames",
                      AMF_VIDEO_ENCODER_MAX_NUM_REFRAMES, 0, 16, 4}},
-    // The following block can only be set when max num reframes is > 1.
-    // Skipping them because need to find a clean way to conditionally disable
-    // them and they are conditionally disable them and they are niche.
+    // B-frames are reordered which OBS is told about through the packet DTS.
+    S{new IntSetting{"b pic pattern", "B Frames",
+                     AMF_VIDEO_ENCODER_B_PIC_PATTERN, 0, 3, 0}},
+    S{new BoolSetting{"b reference enable", "Use B Frames As References",
+                      AMF_VIDEO_ENCODER_B_REFERENCE_ENABLE, false}},
+    S{new BoolSetting{"adaptive minigop", "Adaptive Number of B Frames",
+                      AMF_VIDEO_ENCODER_ADAPTIVE_MINIGOP, false}},
+    S{new IntSetting{"b pic delta qp", "B Frame Delta QP",
+                     AMF_VIDEO_ENCODER_B_PIC_DELTA_QP, -10, 10, 4}},
+    S{new IntSetting{"ref b pic delta qp", "Reference B Frame Delta QP",
+                     AMF_VIDEO_ENCODER_REF_B_PIC_DELTA_QP, -10, 10, 2}},
+    // Skipping intra refresh because we need a clean way to conditionally
+    // disable it and it is niche.
     /*
-    result.emplace_back(new IntSetting{"b pic delta qp", "B Frame Delta QP",
-                                       AMF_VIDEO_ENCODER_B_PIC_DELTA_QP, -10,
-    10, 4}); result.emplace_back( new IntSetting{"ref b pic delta qp",
-    "Reference B Frame Delta QP", AMF_VIDEO_ENCODER_REF_B_PIC_DELTA_QP, -10, 10,
-    2}); result.emplace_back(new IntSetting{ "intra refresh num mbs per slot",
+    result.emplace_back(new IntSetting{ "intra refresh num mbs per slot",
     "Intra Refresh Macroblocks Per Slot",
         AMF_VIDEO_ENCODER_INTRA_REFRESH_NUM_MBS_PER_SLOT, 0,
         std::numeric_limits<int>::max(), 0});
-    result.emplace_back(new IntSetting{"b pic pattern", "B Frame Pattern",
-                                       AMF_VIDEO_ENCODER_B_PIC_PATTERN, 0, 3,
-    3}); result.emplace_back( new BoolSetting{"b reference enable", "Use B
-    Frames As References", AMF_VIDEO_ENCODER_B_REFERENCE_ENABLE, true});
     */
     S{new IntSetting{"header insertion spacing", "Header Insertion Spacing",
                      AMF_VIDEO_ENCODER_HEADER_INSERTION_SPACING, 0, 1000, 0}},
@@ -208,3 +306,5 @@ const S settings_[] = {
 } // namespace
 
 const std::span<const S> EncoderAvc::settings{settings_};
+
+const CapsProperties &EncoderAvc::caps_properties{avc_caps_properties};
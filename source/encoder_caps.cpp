@@ -0,0 +1,268 @@
+#include "encoder_caps.h"
+
+#include "util.h"
+
+#include <AMF/components/ComponentCaps.h>
+#include <AMF/components/VideoEncoderHEVC.h>
+#include <AMF/components/VideoEncoderVCE.h>
+#include <fmt/core.h>
+#include <util/platform.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+const CapsProperties avc_caps_properties{
+    .codec = "avc",
+    .component = AMFVideoEncoderVCE_AVC,
+    .max_bitrate = AMF_VIDEO_ENCODER_CAP_MAX_BITRATE,
+    .max_profile = AMF_VIDEO_ENCODER_CAP_MAX_PROFILE,
+    .max_tier = nullptr,
+    .max_level = AMF_VIDEO_ENCODER_CAP_MAX_LEVEL,
+    .max_reference_frames = AMF_VIDEO_ENCODER_CAP_MAX_REFERENCE_FRAMES,
+    .max_throughput = AMF_VIDEO_ENCODER_CAP_MAX_THROUGHPUT,
+    .hw_instances = AMF_VIDEO_ENCODER_CAP_NUM_OF_HW_INSTANCES,
+    .pre_analysis = AMF_VIDEO_ENCODER_CAP_PRE_ANALYSIS,
+    .b_frames = AMF_VIDEO_ENCODER_CAP_BFRAMES,
+};
+
+const CapsProperties hevc_caps_properties{
+    .codec = "hevc",
+    .component = AMFVideoEncoder_HEVC,
+    .max_bitrate = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_BITRATE,
+    .max_profile = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_PROFILE,
+    .max_tier = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_TIER,
+    .max_level = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_LEVEL,
+    .max_reference_frames = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_REFERENCE_FRAMES,
+    .max_throughput = AMF_VIDEO_ENCODER_HEVC_CAP_MAX_THROUGHPUT,
+    .hw_instances = AMF_VIDEO_ENCODER_HEVC_CAP_NUM_OF_HW_INSTANCES,
+    .pre_analysis = AMF_VIDEO_ENCODER_HEVC_CAP_PRE_ANALYSIS,
+    .b_frames = nullptr,
+};
+
+namespace {
+
+using ObsString = std::unique_ptr<char, decltype(&bfree)>;
+
+constexpr czstring cache_file_name{"encoder_caps.json"};
+
+// Guards the cache file and known_caps.
+std::mutex cache_mutex;
+// Caps that were queried or validated against a device in this process.
+std::map<std::pair<uint32_t, std::string>, EncoderCaps> known_caps;
+
+template <typename T>
+T read_cap(amf::AMFPropertyStorage &caps, cwzstring name, T value = {}) {
+  if (name != nullptr) {
+    caps.GetProperty(name, &value);
+  }
+  return value;
+}
+
+EncoderCaps query_caps(SharedDevice &device, const CapsProperties &names) {
+  amf::AMFComponentPtr component;
+  if (device.amf_factory->CreateComponent(device.amf_context, names.component,
+                                          &component) != AMF_OK) {
+    throw std::runtime_error(
+        fmt::format("{} encoder unavailable", names.codec.get()));
+  }
+  amf::AMFCapsPtr caps;
+  if (component->GetCaps(&caps) != AMF_OK) {
+    component->Terminate();
+    throw std::runtime_error("AMFComponent::GetCaps");
+  }
+  const EncoderCaps result{
+      .max_bitrate = read_cap<int64_t>(*caps, names.max_bitrate),
+      .max_profile = read_cap<int64_t>(*caps, names.max_profile),
+      .max_tier = read_cap<int64_t>(*caps, names.max_tier, -1),
+      .max_level = read_cap<int64_t>(*caps, names.max_level),
+      .max_reference_frames =
+          read_cap<int64_t>(*caps, names.max_reference_frames),
+      .max_throughput = read_cap<int64_t>(*caps, names.max_throughput),
+      .hw_instances = read_cap<int64_t>(*caps, names.hw_instances),
+      .b_frames = read_cap<bool>(*caps, names.b_frames),
+      .pre_analysis = read_cap<bool>(*caps, names.pre_analysis),
+  };
+  caps = nullptr;
+  component->Terminate();
+  return result;
+}
+
+ObsString cache_path() {
+  return {obs_module_config_path(cache_file_name), bfree};
+}
+
+// One entry per codec and adapter. A new driver replaces the entry.
+std::string entry_name(uint32_t adapter, const CapsProperties &names) {
+  return fmt::format("{} {}", names.codec.get(), adapter);
+}
+
+// The cache is only valid for the same hardware, driver and AMF runtime.
+void write_identity(obs_data &entry, const SharedDevice &device) {
+  obs_data_set_int(&entry, "device id", device.adapter_desc.DeviceId);
+  obs_data_set_int(&entry, "revision", device.adapter_desc.Revision);
+  obs_data_set_int(&entry, "driver version", device.driver_version);
+  obs_data_set_int(&entry, "runtime version",
+                   static_cast<long long>(device.amf.version()));
+}
+
+bool identity_matches(obs_data &entry, const SharedDevice &device) {
+  return obs_data_get_int(&entry, "device id") ==
+             device.adapter_desc.DeviceId &&
+         obs_data_get_int(&entry, "revision") == device.adapter_desc.Revision &&
+         obs_data_get_int(&entry, "driver version") == device.driver_version &&
+         obs_data_get_int(&entry, "runtime version") ==
+             static_cast<long long>(device.amf.version());
+}
+
+void write_caps(obs_data &entry, const EncoderCaps &caps) {
+  obs_data_set_int(&entry, "max bitrate", caps.max_bitrate);
+  obs_data_set_int(&entry, "max profile", caps.max_profile);
+  obs_data_set_int(&entry, "max tier", caps.max_tier);
+  obs_data_set_int(&entry, "max level", caps.max_level);
+  obs_data_set_int(&entry, "max reference frames", caps.max_reference_frames);
+  obs_data_set_int(&entry, "max throughput", caps.max_throughput);
+  obs_data_set_int(&entry, "hw instances", caps.hw_instances);
+  obs_data_set_bool(&entry, "b frames", caps.b_frames);
+  obs_data_set_bool(&entry, "pre analysis", caps.pre_analysis);
+}
+
+EncoderCaps read_caps(obs_data &entry) {
+  return {
+      .max_bitrate = obs_data_get_int(&entry, "max bitrate"),
+      .max_profile = obs_data_get_int(&entry, "max profile"),
+      .max_tier = obs_data_get_int(&entry, "max tier"),
+      .max_level = obs_data_get_int(&entry, "max level"),
+      .max_reference_frames = obs_data_get_int(&entry, "max reference frames"),
+      .max_throughput = obs_data_get_int(&entry, "max throughput"),
+      .hw_instances = obs_data_get_int(&entry, "hw instances"),
+      .b_frames = obs_data_get_bool(&entry, "b frames"),
+      .pre_analysis = obs_data_get_bool(&entry, "pre analysis"),
+  };
+}
+
+ObsData load_cache_file(czstring path) {
+  ObsData root{obs_data_create_from_json_file_safe(path, "bak"),
+               obs_data_release};
+  if (!root) {
+    root.reset(obs_data_create());
+  }
+  return root;
+}
+
+void save_cache_file(czstring path, obs_data &root) {
+  const ObsString directory{obs_module_config_path(""), bfree};
+  if (!directory || os_mkdirs(directory.get()) == MKDIR_ERROR ||
+      !obs_data_save_json_safe(&root, path, "tmp", "bak")) {
+    log(LOG_WARNING, "cannot write encoder caps cache {}", path);
+  }
+}
+
+void log_caps(const CapsProperties &names, const EncoderCaps &caps,
+              czstring source) {
+  log(LOG_INFO,
+      "{} caps ({}): max bitrate {}, max profile {}, max tier {}, max level "
+      "{}, max reference frames {}, max throughput {}, hw instances {}, b "
+      "frames {}, pre-analysis {}",
+      names.codec.get(), source, caps.max_bitrate, caps.max_profile,
+      caps.max_tier, caps.max_level, caps.max_reference_frames,
+      caps.max_throughput, caps.hw_instances, caps.b_frames,
+      caps.pre_analysis);
+}
+
+int64_t ranked(const SettingLimit &limit, int64_t value) {
+  return limit.rank ? limit.rank(value) : value;
+}
+
+} // namespace
+
+EncoderCaps get_encoder_caps(SharedDevice &device,
+                             const CapsProperties &names) {
+  std::scoped_lock lock{cache_mutex};
+  const auto name{entry_name(device.adapter, names)};
+  if (const auto known = known_caps.find({device.adapter, names.codec.get()});
+      known != known_caps.end()) {
+    return known->second;
+  }
+  const auto path{cache_path()};
+  ObsData root{nullptr, obs_data_release};
+  if (path) {
+    root = load_cache_file(path.get());
+    const ObsData entry{obs_data_get_obj(root.get(), name.c_str()),
+                        obs_data_release};
+    if (entry && identity_matches(*entry, device)) {
+      const auto caps{read_caps(*entry)};
+      log_caps(names, caps, "cached");
+      known_caps.emplace(std::pair{device.adapter, names.codec.get()}, caps);
+      return caps;
+    }
+  }
+  const auto caps{query_caps(device, names)};
+  log_caps(names, caps, "queried");
+  known_caps.emplace(std::pair{device.adapter, names.codec.get()}, caps);
+  if (root) {
+    const ObsData entry{obs_data_create(), obs_data_release};
+    write_identity(*entry, device);
+    write_caps(*entry, caps);
+    obs_data_set_obj(root.get(), name.c_str(), entry.get());
+    save_cache_file(path.get(), *root);
+  }
+  return caps;
+}
+
+std::optional<EncoderCaps> known_encoder_caps(uint32_t adapter,
+                                              const CapsProperties &names) {
+  std::scoped_lock lock{cache_mutex};
+  const auto known{known_caps.find({adapter, names.codec.get()})};
+  if (known == known_caps.end()) {
+    return std::nullopt;
+  }
+  return known->second;
+}
+
+void enforce_setting_limits(obs_data &data, amf::AMFComponent &encoder,
+                            std::span<const SettingLimit> limits) {
+  for (const auto &limit : limits) {
+    const int64_t value{obs_data_get_int(&data, limit.setting)};
+    if (ranked(limit, value) <= ranked(limit, limit.max)) {
+      continue;
+    }
+    if (!limit.clamp) {
+      throw std::runtime_error(
+          fmt::format("{} {} is not supported by the hardware, maximum is {}",
+                      limit.setting.get(), value, limit.max));
+    }
+    log(LOG_WARNING, "{} {} lowered to hardware maximum {}",
+        limit.setting.get(), value, limit.max);
+    set_property_fallible(encoder, limit.amf_name, limit.max);
+  }
+}
+
+void restrict_properties(obs_properties &properties,
+                         std::span<const SettingLimit> limits) noexcept {
+  for (const auto &limit : limits) {
+    auto *const property{obs_properties_get(&properties, limit.setting)};
+    if (!property) {
+      continue;
+    }
+    if (limit.clamp) {
+      const auto min{obs_property_int_min(property)};
+      const auto max{std::clamp<int64_t>(limit.max, min,
+                                         std::numeric_limits<int>::max())};
+      obs_property_int_set_limits(property, min, static_cast<int>(max),
+                                  obs_property_int_step(property));
+      continue;
+    }
+    const auto count{obs_property_list_item_count(property)};
+    for (size_t i{0}; i < count; ++i) {
+      const auto value{obs_property_list_item_int(property, i)};
+      obs_property_list_item_disable(
+          property, i, ranked(limit, value) > ranked(limit, limit.max));
+    }
+  }
+}
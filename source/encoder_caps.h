@@ -0,0 +1,85 @@
+#pragma once
+
+// The hardware limits of the encoders. Querying them requires creating an AMF
+// component which is slow so the results are cached in memory and in a file in
+// the plugin's config directory.
+
+#include "device_registry.h"
+#include "gsl.h"
+
+#include <AMF/components/Component.h>
+#include <obs-module.h>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Names of the capabilities of one AMF encoder component.
+struct CapsProperties {
+  // Identifies the component in the cache and in logs.
+  not_null<czstring> codec;
+  not_null<cwzstring> component;
+  not_null<cwzstring> max_bitrate;
+  not_null<cwzstring> max_profile;
+  // nullptr when the codec has no tiers.
+  cwzstring max_tier;
+  not_null<cwzstring> max_level;
+  not_null<cwzstring> max_reference_frames;
+  not_null<cwzstring> max_throughput;
+  not_null<cwzstring> hw_instances;
+  not_null<cwzstring> pre_analysis;
+  // nullptr when the codec has no B-frames.
+  cwzstring b_frames;
+};
+
+extern const CapsProperties avc_caps_properties;
+extern const CapsProperties hevc_caps_properties;
+
+// Zero means the runtime did not report the capability.
+struct EncoderCaps {
+  int64_t max_bitrate{0};
+  int64_t max_profile{0};
+  // -1 when not reported because 0 is the main tier.
+  int64_t max_tier{-1};
+  int64_t max_level{0};
+  int64_t max_reference_frames{0};
+  // In 16x16 macroblocks per second.
+  int64_t max_throughput{0};
+  int64_t hw_instances{0};
+  bool b_frames{false};
+  bool pre_analysis{false};
+};
+
+// Returns the caps of the component on the device. Uses the cache if it was
+// filled for the same adapter, driver and runtime version. Otherwise queries
+// AMF and updates the cache. Thread safe.
+EncoderCaps get_encoder_caps(SharedDevice &, const CapsProperties &);
+
+// Returns the caps found by an earlier get_encoder_caps for the adapter. Used
+// where there is no device like when OBS asks for the properties.
+std::optional<EncoderCaps> known_encoder_caps(uint32_t adapter,
+                                              const CapsProperties &);
+
+// How a capability restricts one setting.
+struct SettingLimit {
+  not_null<czstring> setting;
+  not_null<cwzstring> amf_name;
+  int64_t max;
+  // Larger values are lowered to max. Otherwise they are an error.
+  bool clamp;
+  // Maps values to the order in which they are compared with max. For enums
+  // whose values are not sorted by capability. nullptr for the identity.
+  int64_t (*rank)(int64_t){nullptr};
+};
+
+// Throws for settings exceeding a limit that does not clamp and lowers the
+// AMF property of settings exceeding a clamping limit. Call after the settings
+// have been set on the encoder and before initializing it.
+void enforce_setting_limits(obs_data &, amf::AMFComponent &,
+                            std::span<const SettingLimit>);
+
+// Lowers the maximum of integer properties and disables list entries that
+// exceed the limits.
+void restrict_properties(obs_properties &,
+                         std::span<const SettingLimit>) noexcept;
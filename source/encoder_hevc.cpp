@@ -41,11 +41,51 @@ PacketInfo EncoderHevc::get_packet_info(amf::AMFPropertyStorage &output) {
   throw std::runtime_error(fmt::format("unknown packet type {}", packet_type));
 }
 
+int64_t EncoderHevc::reorder_depth(amf::AMFPropertyStorage &) {
+  // The HEVC encoder does not produce B-frames.
+  return 0;
+}
+
+std::vector<SettingLimit>
+EncoderHevc::setting_limits(const EncoderCaps &caps) {
+  std::vector<SettingLimit> limits;
+  if (caps.max_bitrate > 0) {
+    limits.push_back({"target bit rate", AMF_VIDEO_ENCODER_HEVC_TARGET_BITRATE,
+                      caps.max_bitrate, true});
+    limits.push_back({"peak bit rate", AMF_VIDEO_ENCODER_HEVC_PEAK_BITRATE,
+                      caps.max_bitrate, true});
+  }
+  if (caps.max_reference_frames > 0) {
+    limits.push_back({"max num reframes",
+                      AMF_VIDEO_ENCODER_HEVC_MAX_NUM_REFRAMES,
+                      caps.max_reference_frames, true});
+  }
+  if (caps.max_profile > 0) {
+    limits.push_back({"profile", AMF_VIDEO_ENCODER_HEVC_PROFILE,
+                      caps.max_profile, false});
+  }
+  if (caps.max_tier >= 0) {
+    limits.push_back(
+        {"tier", AMF_VIDEO_ENCODER_HEVC_TIER, caps.max_tier, false});
+  }
+  if (caps.max_level > 0) {
+    limits.push_back({"level", AMF_VIDEO_ENCODER_HEVC_PROFILE_LEVEL,
+                      caps.max_level, false});
+  }
+  return limits;
+}
+
 EncoderHevc::EncoderHevc()
     : Encoder({
           .amf_encoder_name = AMFVideoEncoder_HEVC,
+          .codec = Codec::Hevc,
           .extra_data_property = AMF_VIDEO_ENCODER_HEVC_EXTRADATA,
           .frame_rate_property = AMF_VIDEO_ENCODER_HEVC_FRAMERATE,
+          .query_timeout_property = AMF_VIDEO_ENCODER_HEVC_QUERY_TIMEOUT,
+          .query_timeout_support_cap =
+              AMF_VIDEO_ENCODER_CAPS_HEVC_QUERY_TIMEOUT_SUPPORT,
+          .target_bitrate_property = AMF_VIDEO_ENCODER_HEVC_TARGET_BITRATE,
+          .peak_bitrate_property = AMF_VIDEO_ENCODER_HEVC_PEAK_BITRATE,
           .input_color_properties =
               {.profile = AMF_VIDEO_ENCODER_HEVC_INPUT_COLOR_PROFILE,
                .transfer_characteristic =
@@ -56,6 +96,36 @@ EncoderHevc::EncoderHevc()
                .transfer_characteristic =
                    AMF_VIDEO_ENCODER_HEVC_OUTPUT_TRANSFER_CHARACTERISTIC,
                .primaries = AMF_VIDEO_ENCODER_HEVC_OUTPUT_COLOR_PRIMARIES},
+          .quality_properties =
+              {.preset = AMF_VIDEO_ENCODER_HEVC_QUALITY_PRESET,
+               .presets = {AMF_VIDEO_ENCODER_HEVC_QUALITY_PRESET_QUALITY,
+                           AMF_VIDEO_ENCODER_HEVC_QUALITY_PRESET_BALANCED,
+                           AMF_VIDEO_ENCODER_HEVC_QUALITY_PRESET_SPEED},
+               .motion_half_pixel = AMF_VIDEO_ENCODER_HEVC_MOTION_HALF_PIXEL,
+               .motion_quarter_pixel =
+                   AMF_VIDEO_ENCODER_HEVC_MOTION_QUARTERPIXEL},
+          .telemetry_properties =
+              {.statistics_feedback =
+                   AMF_VIDEO_ENCODER_HEVC_STATISTICS_FEEDBACK,
+               .psnr_feedback = AMF_VIDEO_ENCODER_HEVC_PSNR_FEEDBACK,
+               .ssim_feedback = AMF_VIDEO_ENCODER_HEVC_SSIM_FEEDBACK,
+               .frame_qp = AMF_VIDEO_ENCODER_HEVC_STATISTIC_FRAME_QP,
+               .average_qp = AMF_VIDEO_ENCODER_HEVC_STATISTIC_AVERAGE_QP,
+               .min_qp = AMF_VIDEO_ENCODER_HEVC_STATISTIC_MIN_QP,
+               .max_qp = AMF_VIDEO_ENCODER_HEVC_STATISTIC_MAX_QP,
+               .intra_pixels = AMF_VIDEO_ENCODER_HEVC_STATISTIC_PIX_NUM_INTRA,
+               .inter_pixels = AMF_VIDEO_ENCODER_HEVC_STATISTIC_PIX_NUM_INTER,
+               .skip_pixels = AMF_VIDEO_ENCODER_HEVC_STATISTIC_PIX_NUM_SKIP,
+               .residual_bits =
+                   AMF_VIDEO_ENCODER_HEVC_STATISTIC_BITCOUNT_RESIDUAL,
+               .motion_bits = AMF_VIDEO_ENCODER_HEVC_STATISTIC_BITCOUNT_MOTION,
+               .bits_without_header =
+                   AMF_VIDEO_ENCODER_HEVC_STATISTIC_BITCOUNT_ALL_MINUS_HEADER,
+               .psnr = AMF_VIDEO_ENCODER_HEVC_STATISTIC_PSNR_ALL,
+               .ssim = AMF_VIDEO_ENCODER_HEVC_STATISTIC_SSIM_ALL},
+          .settings = settings,
+          .caps_properties = &caps_properties,
+          .setting_limits = setting_limits,
       }) {}
 
 namespace {
@@ -110,30 +180,31 @@ const S settings_[] = {
          {AMF_VIDEO_ENCODER_HEVC_RATE_CONTROL_METHOD_LATENCY_CONSTRAINED_VBR,
           "Latency Constrained Variable Bit Rate"}},
         0}},
+    // The trailing true marks settings that can change while encoding.
     S{new IntSetting{"target bit rate", "Target Bit Rate",
                      AMF_VIDEO_ENCODER_HEVC_TARGET_BITRATE, 1,
-                     std::numeric_limits<int>::max(), 10000000}},
+                     std::numeric_limits<int>::max(), 10000000, true}},
     S{new IntSetting{"peak bit rate", "Peak Bit Rate",
                      AMF_VIDEO_ENCODER_HEVC_PEAK_BITRATE, 1,
-                     std::numeric_limits<int>::max(), 30000000}},
+                     std::numeric_limits<int>::max(), 30000000, true}},
     S{new BoolSetting{"skip frame enable", "Skip Frames for Rate Control",
                       AMF_VIDEO_ENCODER_HEVC_RATE_CONTROL_SKIP_FRAME_ENABLE,
                       false}},
     S{new IntSetting{"min qp i", "Minimum I Frame QP",
-                     AMF_VIDEO_ENCODER_HEVC_MIN_QP_I, 0, 51, 18}},
+                     AMF_VIDEO_ENCODER_HEVC_MIN_QP_I, 0, 51, 18, true}},
     S{new IntSetting{"max qp i", "Maximum I Frame QP",
-                     AMF_VIDEO_ENCODER_HEVC_MAX_QP_I, 0, 51, 46}},
+                     AMF_VIDEO_ENCODER_HEVC_MAX_QP_I, 0, 51, 46, true}},
     S{new IntSetting{"min qp p", "Minimum P Frame QP",
-                     AMF_VIDEO_ENCODER_HEVC_MIN_QP_P, 0, 51, 18}},
+                     AMF_VIDEO_ENCODER_HEVC_MIN_QP_P, 0, 51, 18, true}},
     S{new IntSetting{"max qp p", "Maximum P Frame QP",
-                     AMF_VIDEO_ENCODER_HEVC_MAX_QP_P, 0, 51, 46}},
+                     AMF_VIDEO_ENCODER_HEVC_MAX_QP_P, 0, 51, 46, true}},
     S{new IntSetting{"qp i", "CQP: I Frame QP", AMF_VIDEO_ENCODER_HEVC_QP_I, 0,
-                     51, 26}},
+                     51, 26, true}},
     S{new IntSetting{"qp p", "CQP: P Frame QP", AMF_VIDEO_ENCODER_HEVC_QP_P, 0,
-                     51, 26}},
+                     51, 26, true}},
     S{new IntSetting{"vbv buffer size", "VBV Buffer Size",
                      AMF_VIDEO_ENCODER_HEVC_VBV_BUFFER_SIZE, 1,
-                     std::numeric_limits<int>::max(), 20000000}},
+                     std::numeric_limits<int>::max(), 20000000, true}},
     S{new IntSetting{
         "initial vbv buffer fullness", "Initial VBV Buffer Fullness",
         AMF_VIDEO_ENCODER_HEVC_INITIAL_VBV_BUFFER_FULLNESS, 0, 64, 64}},
@@ -191,3 +262,5 @@ const S settings_[] = {
 } // namespace
 
 const std::span<const S> EncoderHevc::settings{settings_};
+
+const CapsProperties &EncoderHevc::caps_properties{hevc_caps_properties};
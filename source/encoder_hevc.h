@@ -9,9 +9,12 @@ class EncoderHevc : public Encoder {
                                                 obs_data &) override;
   void set_color_range(amf::AMFPropertyStorage &, ColorRange) override;
   PacketInfo get_packet_info(amf::AMFPropertyStorage &) override;
+  int64_t reorder_depth(amf::AMFPropertyStorage &) override;
 
 public:
   static const std::span<const std::unique_ptr<const Setting>> settings;
+  static const CapsProperties &caps_properties;
+  static std::vector<SettingLimit> setting_limits(const EncoderCaps &);
 
   EncoderHevc();
 };
@@ -0,0 +1,191 @@
+#include "encoder_stats.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Frames that never produce a packet would otherwise accumulate.
+constexpr size_t max_in_flight{256};
+
+double milliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// JSON has no NaN.
+std::string json_number(double value) {
+  return std::isnan(value) ? "null" : fmt::format("{:.4f}", value);
+}
+
+} // namespace
+
+void LatencyTracker::submitted(int64_t pts, Clock::time_point time) {
+  if (in_flight.size() == max_in_flight) {
+    in_flight.pop_front();
+  }
+  in_flight.emplace_back(pts, time);
+}
+
+std::optional<std::chrono::microseconds>
+LatencyTracker::output(int64_t pts, Clock::time_point time) {
+  // Packets come out close to submission order so this is short.
+  const auto frame{std::find_if(in_flight.begin(), in_flight.end(),
+                                [=](const auto &f) { return f.first == pts; })};
+  if (frame == in_flight.end()) {
+    return std::nullopt;
+  }
+  const auto latency{std::chrono::duration_cast<std::chrono::microseconds>(
+      time - frame->second)};
+  in_flight.erase(frame);
+  return latency;
+}
+
+std::string format_stats_summary(const EncoderStats &stats,
+                                 const EncoderGauges &gauges) {
+  auto summary{fmt::format(
+      "stats: {} frames, {} packets, {} bytes, {} repeats, {} input full ({} "
+      "frames), {} dropped, latency p50 {} us p90 {} us p99 {} us, copy "
+      "{:.1f} ms for {} frames ({} zero copy), pending input {} (max {}), "
+      "output queue {}",
+      stats.frames_submitted, stats.packets, stats.bytes_out, stats.repeats,
+      stats.input_full, stats.input_full_frames, stats.dropped_frames,
+      stats.latency.percentile(50).count(),
+      stats.latency.percentile(90).count(),
+      stats.latency.percentile(99).count(), milliseconds(stats.copy_time),
+      stats.zero_copy_frames + stats.copied_frames, stats.zero_copy_frames,
+      gauges.pending_input, stats.pending_input_high_water_mark,
+      gauges.output_queue)};
+  if (stats.bounded_waits > 0) {
+    summary += fmt::format(", {} of {} bounded waits timed out",
+                           stats.bounded_wait_timeouts, stats.bounded_waits);
+  }
+  if (gauges.host_surface_pool) {
+    const auto &pool{*gauges.host_surface_pool};
+    summary += fmt::format(
+        ", surface pool {} hits {} misses {} waits high water mark {}",
+        pool.hits, pool.misses, pool.waits, pool.high_water_mark);
+  }
+  if (gauges.shared_texture_cache && gauges.shared_texture_cache->opens > 0) {
+    const auto &cache{*gauges.shared_texture_cache};
+    summary += fmt::format(", texture cache {} hits {} opens {} evictions",
+                           cache.hits, cache.opens, cache.evictions);
+  }
+  if (gauges.texture_ring) {
+    const auto &ring{*gauges.texture_ring};
+    summary += fmt::format(
+        ", texture ring {} stalls {} skips high water mark {}", ring.stalls,
+        ring.skips, ring.high_water_mark);
+  }
+  if (gauges.keyed_mutex) {
+    const auto &mutex{*gauges.keyed_mutex};
+    summary += fmt::format(
+        ", texture acquire p50 {} us p99 {} us {} timeouts {} repeats",
+        mutex.wait.percentile(50).count(), mutex.wait.percentile(99).count(),
+        mutex.timeouts, mutex.repeats);
+  }
+  if (gauges.target_bitrate) {
+    summary += fmt::format(", target bitrate {} kbps after {} changes",
+                           *gauges.target_bitrate / 1000,
+                           stats.bitrate_changes);
+  }
+  if (gauges.quality_level) {
+    summary += fmt::format(", quality level {} after {} changes",
+                           *gauges.quality_level, stats.quality_level_changes);
+  }
+  if (gauges.telemetry && gauges.telemetry->frames > 0) {
+    const auto &telemetry{*gauges.telemetry};
+    summary += fmt::format(
+        ", last {} frames qp {:.1f} intra {:.1f}% skip {:.1f}%",
+        telemetry.frames, telemetry.average_qp,
+        telemetry.intra_fraction * 100, telemetry.skip_fraction * 100);
+    if (!std::isnan(telemetry.psnr)) {
+      summary += fmt::format(" psnr {:.2f} (min {:.2f})", telemetry.psnr,
+                             telemetry.min_psnr);
+    }
+    if (!std::isnan(telemetry.ssim)) {
+      summary += fmt::format(" ssim {:.4f}", telemetry.ssim);
+    }
+  }
+  if (stats.filler_bytes_stripped > 0) {
+    summary += fmt::format(", {} filler bytes stripped",
+                           stats.filler_bytes_stripped);
+  }
+  if (stats.dts_violations > 0) {
+    summary += fmt::format(", {} invalid dts", stats.dts_violations);
+  }
+  return summary;
+}
+
+std::string format_stats_json(const EncoderStats &stats,
+                              const EncoderGauges &gauges) {
+  const auto now{std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch())};
+  auto json{fmt::format(
+      R"({{"time_ms":{},"frames_submitted":{},"packets":{},"bytes_out":{},)"
+      R"("repeats":{},"input_full":{},"input_full_frames":{},)"
+      R"("dropped_frames":{},)"
+      R"("latency_us":{{"count":{},"p50":{},"p90":{},"p99":{}}},)"
+      R"("copy_ms":{:.3f},"zero_copy_frames":{},"copied_frames":{},)"
+      R"("pending_input":{},"pending_input_max":{},"output_queue":{},)"
+      R"("bounded_waits":{},"bounded_wait_timeouts":{},"dts_violations":{},)"
+      R"("filler_bytes_stripped":{})",
+      now.count(), stats.frames_submitted, stats.packets, stats.bytes_out,
+      stats.repeats, stats.input_full, stats.input_full_frames,
+      stats.dropped_frames, stats.latency.count(),
+      stats.latency.percentile(50).count(),
+      stats.latency.percentile(90).count(),
+      stats.latency.percentile(99).count(), milliseconds(stats.copy_time),
+      stats.zero_copy_frames, stats.copied_frames, gauges.pending_input,
+      stats.pending_input_high_water_mark, gauges.output_queue,
+      stats.bounded_waits, stats.bounded_wait_timeouts, stats.dts_violations,
+      stats.filler_bytes_stripped)};
+  if (gauges.host_surface_pool) {
+    const auto &pool{*gauges.host_surface_pool};
+    json += fmt::format(
+        R"(,"surface_pool":{{"hits":{},"misses":{},"waits":{},"max":{}}})",
+        pool.hits, pool.misses, pool.waits, pool.high_water_mark);
+  }
+  if (gauges.shared_texture_cache) {
+    const auto &cache{*gauges.shared_texture_cache};
+    json += fmt::format(
+        R"(,"texture_cache":{{"hits":{},"opens":{},"evictions":{}}})",
+        cache.hits, cache.opens, cache.evictions);
+  }
+  if (gauges.texture_ring) {
+    const auto &ring{*gauges.texture_ring};
+    json += fmt::format(
+        R"(,"texture_ring":{{"stalls":{},"skips":{},"max":{}}})",
+        ring.stalls, ring.skips, ring.high_water_mark);
+  }
+  if (gauges.keyed_mutex) {
+    const auto &mutex{*gauges.keyed_mutex};
+    json += fmt::format(
+        R"(,"texture_acquire":{{"timeouts":{},"repeats":{},)"
+        R"("wait_us":{{"count":{},"p50":{},"p90":{},"p99":{}}}}})",
+        mutex.timeouts, mutex.repeats, mutex.wait.count(),
+        mutex.wait.percentile(50).count(), mutex.wait.percentile(90).count(),
+        mutex.wait.percentile(99).count());
+  }
+  if (gauges.target_bitrate) {
+    json += fmt::format(R"(,"bitrate":{{"target":{},"changes":{}}})",
+                        *gauges.target_bitrate, stats.bitrate_changes);
+  }
+  if (gauges.quality_level) {
+    json += fmt::format(R"(,"quality":{{"level":{},"changes":{}}})",
+                        *gauges.quality_level, stats.quality_level_changes);
+  }
+  if (gauges.telemetry) {
+    const auto &telemetry{*gauges.telemetry};
+    json += fmt::format(
+        R"(,"telemetry":{{"frames":{},"average_qp":{},"intra_fraction":{},)"
+        R"("skip_fraction":{},"psnr":{},"min_psnr":{},"ssim":{}}})",
+        telemetry.frames, json_number(telemetry.average_qp),
+        json_number(telemetry.intra_fraction),
+        json_number(telemetry.skip_fraction), json_number(telemetry.psnr),
+        json_number(telemetry.min_psnr), json_number(telemetry.ssim));
+  }
+  json += '}';
+  return json;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "host_surface_pool.h"
+#include "latency_histogram.h"
+#include "shared_texture_cache.h"
+#include "telemetry.h"
+#include "texture_encoder.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+
+// Remembers when frames were submitted so that the latency of their packets
+// can be measured. Packets are matched by PTS because B-frames reorder them.
+class LatencyTracker {
+  using Clock = std::chrono::steady_clock;
+  // Oldest first. Bounded in case the encoder skips frames.
+  std::deque<std::pair<int64_t, Clock::time_point>> in_flight;
+
+public:
+  void submitted(int64_t pts, Clock::time_point);
+  // nullopt if no frame with this PTS is in flight.
+  std::optional<std::chrono::microseconds> output(int64_t pts,
+                                                  Clock::time_point);
+};
+
+// Counters maintained by the encoder on the OBS thread. Cheap enough to always
+// be on.
+struct EncoderStats {
+  uint64_t frames_submitted{0};
+  uint64_t packets{0};
+  uint64_t bytes_out{0};
+  // QueryOutput returned AMF_REPEAT.
+  uint64_t repeats{0};
+  // SubmitInput returned AMF_INPUT_FULL. Counts every retry of a held back
+  // frame.
+  uint64_t input_full{0};
+  // Frames that found the input full at least once.
+  uint64_t input_full_frames{0};
+  uint64_t dropped_frames{0};
+  size_t pending_input_high_water_mark{0};
+  // CPU frames that were uploaded from OBS memory directly and frames that
+  // were copied into a host surface.
+  uint64_t zero_copy_frames{0};
+  uint64_t copied_frames{0};
+  // Time spent getting CPU frames into surfaces.
+  std::chrono::nanoseconds copy_time{0};
+  uint64_t bounded_waits{0};
+  uint64_t bounded_wait_timeouts{0};
+  uint64_t dts_violations{0};
+  // Removed because of Options::strip_filler_data.
+  uint64_t filler_bytes_stripped{0};
+  // Target bitrate changes by the adaptive bitrate controller.
+  uint64_t bitrate_changes{0};
+  // Quality level changes by the overload governor.
+  uint64_t quality_level_changes{0};
+  // Submit to output latency since the last report.
+  LatencyHistogram latency;
+};
+
+// Values that are sampled when reporting instead of being counted.
+struct EncoderGauges {
+  size_t pending_input;
+  size_t output_queue;
+  std::optional<HostSurfacePoolStats> host_surface_pool;
+  std::optional<SharedTextureCacheStats> shared_texture_cache;
+  std::optional<TextureRingStats> texture_ring;
+  // Wait histogram since the last report.
+  std::optional<KeyedMutexStats> keyed_mutex;
+  // Set by the adaptive bitrate controller.
+  std::optional<int64_t> target_bitrate;
+  // Set by the overload governor. 0 is the user's configuration.
+  std::optional<uint32_t> quality_level;
+  // Recent frames when per frame telemetry is on.
+  std::optional<TelemetrySummary> telemetry;
+};
+
+// One line for the OBS log.
+std::string format_stats_summary(const EncoderStats &, const EncoderGauges &);
+// One JSON object without trailing newline for a JSON lines file.
+std::string format_stats_json(const EncoderStats &, const EncoderGauges &);
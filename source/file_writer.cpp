@@ -0,0 +1,48 @@
+#include "file_writer.h"
+
+#include <fmt/core.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+std::ofstream open_for_append(const std::string &path) {
+  std::ofstream file{path, std::ios::app};
+  if (!file) {
+    throw std::runtime_error(fmt::format("cannot open {}", path));
+  }
+  return file;
+}
+
+} // namespace
+
+FileWriter::FileWriter(const std::string &path)
+    : file{open_for_append(path)}, thread{[this](std::stop_token stop) {
+        run(stop);
+      }} {}
+
+void FileWriter::run(std::stop_token stop) noexcept {
+  std::string writing;
+  for (;;) {
+    {
+      std::unique_lock lock{mutex};
+      // Keeps returning true after a stop request until everything pending
+      // has been written.
+      if (!text_available.wait(lock, stop, [&] { return !pending.empty(); })) {
+        return;
+      }
+      std::swap(writing, pending);
+    }
+    file << writing << std::flush;
+    writing.clear();
+  }
+}
+
+void FileWriter::write(std::string_view text) {
+  {
+    std::scoped_lock lock{mutex};
+    pending += text;
+  }
+  text_available.notify_one();
+}
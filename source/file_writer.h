@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Appends text to a file on a background thread so that the encode thread
+// never waits for the disk. Text written before destruction is in the file
+// once the destructor returns.
+class FileWriter {
+  std::ofstream file;
+  std::mutex mutex;
+  std::condition_variable_any text_available;
+  // Written but not handed to the file yet.
+  std::string pending;
+  // Declared last so that it is joined before the above is destroyed.
+  std::jthread thread;
+
+  void run(std::stop_token) noexcept;
+
+public:
+  // Throws when the file cannot be opened.
+  explicit FileWriter(const std::string &path);
+
+  // Delete moving and copying because the thread refers to this.
+  FileWriter(const FileWriter &) = delete;
+  FileWriter(FileWriter &&) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+  FileWriter &operator=(FileWriter &&) = delete;
+
+  void write(std::string_view text);
+};
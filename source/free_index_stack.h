@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+
+// Lock free stack of the indices 0 to capacity - 1 for any number of pushing
+// threads and exactly one popping thread. Used to hand slots released on other
+// threads back to the owner without making either side wait.
+//
+// The usual ABA problem of lock free stacks needs an index to be popped and
+// pushed again while another pop is in progress. With a single popping thread
+// that cannot happen.
+class FreeIndexStack {
+  static constexpr size_t none{std::numeric_limits<size_t>::max()};
+
+  // next[i] is the index below i. Written before i is published by push and
+  // only read while i is on the stack.
+  std::unique_ptr<size_t[]> next;
+  std::atomic<size_t> head{none};
+
+public:
+  // Starts out empty.
+  explicit FreeIndexStack(size_t capacity) : next{new size_t[capacity]} {}
+
+  FreeIndexStack(const FreeIndexStack &) = delete;
+  FreeIndexStack &operator=(const FreeIndexStack &) = delete;
+
+  // Any thread. index must not be on the stack already.
+  void push(size_t index) noexcept {
+    auto current{head.load(std::memory_order_relaxed)};
+    do {
+      next[index] = current;
+    } while (!head.compare_exchange_weak(current, index,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  // Popping thread only. Returns false when empty.
+  bool pop(size_t &index) noexcept {
+    auto current{head.load(std::memory_order_acquire)};
+    while (current != none &&
+           !head.compare_exchange_weak(current, next[current],
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire)) {
+    }
+    if (current == none) {
+      return false;
+    }
+    index = current;
+    return true;
+  }
+
+  bool empty() const noexcept {
+    return head.load(std::memory_order_relaxed) == none;
+  }
+};
@@ -0,0 +1,124 @@
+#include "host_frame_wrapper.h"
+
+#include "util.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// Alignment that we require of the frame memory and its pitch. OBS aligns its
+// frames to this already.
+constexpr uintptr_t alignment{32};
+
+bool aligned(uintptr_t value) noexcept { return value % alignment == 0; }
+
+// How long to wait for AMF to release a wrapper that it still holds after the
+// upload before giving up on it. The observer may run on another thread.
+constexpr std::chrono::milliseconds release_wait{1};
+
+// Observes one wrapper. Owned by both upload and AMF, and deleted by whichever
+// is done with it last, so that a wrapper that AMF releases late never
+// notifies a destroyed object and we never have to remove the observer.
+class WrapperRelease final : public amf::AMFSurfaceObserver {
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool released{false};
+  std::atomic<int> owners{2};
+
+  void OnSurfaceDataRelease(amf::AMFSurface *) override {
+    {
+      std::scoped_lock lock{mutex};
+      released = true;
+    }
+    condition.notify_one();
+    drop();
+  }
+
+public:
+  // Whether AMF released the wrapper within the timeout.
+  bool wait(std::chrono::milliseconds timeout) {
+    std::unique_lock lock{mutex};
+    return condition.wait_for(lock, timeout, [this] { return released; });
+  }
+  void drop() noexcept {
+    if (owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+} // namespace
+
+HostFrameWrapper::HostFrameWrapper(amf::AMFContextPtr amf_context_,
+                                   amf::AMF_SURFACE_FORMAT format_,
+                                   int32_t width_, int32_t height_)
+    : amf_context{amf_context_}, format{format_}, width{width_},
+      height{height_} {}
+
+bool HostFrameWrapper::eligible(const encoder_frame &frame) const noexcept {
+  const auto base{reinterpret_cast<uintptr_t>(frame.data[0])};
+  const uintptr_t pitch{frame.linesize[0]};
+  if (!enabled || !aligned(base) || !aligned(pitch)) {
+    return false;
+  }
+  // AMF derives the position of the following planes from the pitch and the
+  // number of rows of the first plane.
+  const auto follows = [&](size_t plane, uintptr_t offset) {
+    return reinterpret_cast<uintptr_t>(frame.data[plane]) == base + offset;
+  };
+  switch (format) {
+  case amf::AMF_SURFACE_RGBA:
+    return true;
+  case amf::AMF_SURFACE_NV12: {
+    const auto luma_size{pitch * static_cast<uintptr_t>(height)};
+    return frame.linesize[1] == pitch && follows(1, luma_size);
+  }
+  case amf::AMF_SURFACE_YUV420P: {
+    const auto luma_size{pitch * static_cast<uintptr_t>(height)};
+    const auto chroma_size{pitch / 2 * static_cast<uintptr_t>(height / 2)};
+    return height % 2 == 0 && frame.linesize[1] == pitch / 2 &&
+           frame.linesize[2] == pitch / 2 && follows(1, luma_size) &&
+           follows(2, luma_size + chroma_size);
+  }
+  default:
+    return false;
+  }
+}
+
+amf::AMFSurfacePtr HostFrameWrapper::upload(const encoder_frame &frame) {
+  if (!eligible(frame)) {
+    return nullptr;
+  }
+  auto *const release{new WrapperRelease};
+  amf::AMFSurfacePtr wrapper;
+  if (amf_context->CreateSurfaceFromHostNative(
+          format, width, height, static_cast<amf_int32>(frame.linesize[0]),
+          height, frame.data[0], &wrapper, release) != AMF_OK) {
+    // AMF never got the observer.
+    release->drop();
+    release->drop();
+    throw std::runtime_error("CreateSurfaceFromHostNative");
+  }
+  amf::AMFDataPtr duplicate;
+  const auto duplicated{wrapper->Duplicate(amf::AMF_MEMORY_DX11, &duplicate)};
+  // Usually AMF releases the wrapper along with our reference and the
+  // observer has fired by the time we wait.
+  wrapper = nullptr;
+  const auto released{release->wait(release_wait)};
+  release->drop();
+  if (duplicated != AMF_OK) {
+    throw std::runtime_error("AMFSurface::Duplicate");
+  }
+  if (!released) {
+    // Should not happen. AMF may read the frame after OBS reuses it so we do
+    // not trust the upload and give up on wrapping.
+    log(LOG_ERROR, "host frame wrapper outlived upload, disabling zero copy");
+    enabled = false;
+    return nullptr;
+  }
+  return amf::AMFSurfacePtr{duplicate};
+}
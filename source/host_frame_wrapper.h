@@ -0,0 +1,42 @@
+#pragma once
+
+#include <AMF/core/Context.h>
+#include <AMF/core/Surface.h>
+#include <obs-module.h>
+
+#include <cstdint>
+
+// Uploads OBS frames to the GPU straight from OBS's memory instead of copying
+// them into a host surface first.
+//
+// OBS reuses its frame buffers once encode returns so AMF must not refer to
+// them after that. We wrap the frame with CreateSurfaceFromHostNative,
+// duplicate it into a DX11 surface and drop the wrapper. The D3D11 upload
+// reads the source synchronously. The frame only goes back to OBS once the
+// wrapper's data release observer fired. If it does not fire in time, upload
+// discards the GPU surface so that the frame is copied instead and wrapping
+// stops.
+//
+// Off by default because AMF does not document when it releases the wrapper.
+class HostFrameWrapper {
+  amf::AMFContextPtr amf_context;
+  amf::AMF_SURFACE_FORMAT format;
+  int32_t width;
+  int32_t height;
+  // Cleared when a wrapper outlived upload, which means AMF kept a reference
+  // to OBS memory. We stop wrapping from then on.
+  bool enabled{true};
+
+public:
+  // amf_context must have been initialized with DX11.
+  HostFrameWrapper(amf::AMFContextPtr, amf::AMF_SURFACE_FORMAT, int32_t width,
+                   int32_t height);
+
+  // Whether the frame's planes are laid out the way AMF expects host surfaces
+  // to be: contiguous, aligned and with matching pitches.
+  bool eligible(const encoder_frame &) const noexcept;
+  // Returns a GPU surface with the frame's content or nullptr if the frame
+  // must be copied instead. Neither the returned surface nor AMF refer to the
+  // frame's memory after this returns.
+  amf::AMFSurfacePtr upload(const encoder_frame &);
+};
@@ -0,0 +1,132 @@
+#include "host_surface_pool.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// Generous enough for SIMD copies and DMA from host memory.
+constexpr size_t memory_alignment{4096};
+constexpr int32_t pitch_alignment{256};
+
+constexpr int32_t align(int32_t value, int32_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+HostSurfaceLayout host_surface_layout(amf::AMF_SURFACE_FORMAT format,
+                                      int32_t width, int32_t height) {
+  // Only the formats that obs_format_to_amf produces.
+  switch (format) {
+  case amf::AMF_SURFACE_NV12:
+  case amf::AMF_SURFACE_YUV420P: {
+    const auto h_pitch{align(width, pitch_alignment)};
+    const auto v_pitch{align(height, 2)};
+    // The chroma planes add half of the luma plane.
+    const auto luma{static_cast<size_t>(h_pitch) * v_pitch};
+    return {h_pitch, v_pitch, luma + luma / 2};
+  }
+  case amf::AMF_SURFACE_RGBA: {
+    const auto h_pitch{align(width * 4, pitch_alignment)};
+    return {h_pitch, height, static_cast<size_t>(h_pitch) * height};
+  }
+  default:
+    throw std::runtime_error("host_surface_layout: unknown surface format");
+  }
+}
+
+void HostSurfacePool::Free::operator()(uint8_t *memory) const noexcept {
+  ::operator delete(memory, std::align_val_t{memory_alignment});
+}
+
+HostSurfacePool::HostSurfacePool(amf::AMFContextPtr amf_context_,
+                                 amf::AMF_SURFACE_FORMAT format_,
+                                 int32_t width_, int32_t height_,
+                                 size_t capacity,
+                                 std::chrono::milliseconds wait_timeout_)
+    : amf_context{amf_context_}, format{format_}, width{width_},
+      height{height_}, layout{host_surface_layout(format_, width_, height_)},
+      wait_timeout{wait_timeout_} {
+  slots.reserve(capacity);
+  for (size_t i{0}; i < capacity; ++i) {
+    auto *const memory{static_cast<uint8_t *>(::operator new(
+        layout.size, std::align_val_t{memory_alignment}))};
+    slots.push_back({.memory = std::unique_ptr<uint8_t, Free>{memory},
+                     .surface = nullptr,
+                     .in_use = false});
+  }
+}
+
+HostSurfacePool::~HostSurfacePool() noexcept {
+  // Surfaces point into our memory so they should all be gone. Unregister
+  // anyway so a leaked surface does not call into a destroyed pool.
+  std::lock_guard lock{mutex};
+  for (auto &slot : slots) {
+    if (slot.surface) {
+      log(LOG_WARNING, "HostSurfacePool destroyed while surface in use");
+      slot.surface->RemoveObserver(this);
+    }
+  }
+}
+
+amf::AMFSurfacePtr HostSurfacePool::acquire() {
+  Slot *slot{nullptr};
+  {
+    std::unique_lock lock{mutex};
+    const auto find_free = [&] {
+      const auto free{std::find_if(slots.begin(), slots.end(),
+                                   [](const auto &s) { return !s.in_use; })};
+      slot = free == slots.end() ? nullptr : &*free;
+      return slot != nullptr;
+    };
+    if (!find_free()) {
+      ++stats_.waits;
+      if (!released.wait_for(lock, wait_timeout, find_free)) {
+        ++stats_.misses;
+        return nullptr;
+      }
+    }
+    // Reserve the slot but do not hold the lock while calling into AMF because
+    // AMF may call OnSurfaceDataRelease while holding its own locks.
+    slot->in_use = true;
+    ++in_use;
+    ++stats_.hits;
+    stats_.high_water_mark = std::max(stats_.high_water_mark, in_use);
+  }
+
+  amf::AMFSurfacePtr surface;
+  const auto result{amf_context->CreateSurfaceFromHostNative(
+      format, width, height, layout.h_pitch, layout.v_pitch,
+      slot->memory.get(), &surface, this)};
+  std::lock_guard lock{mutex};
+  if (result != AMF_OK) {
+    slot->in_use = false;
+    --in_use;
+    throw std::runtime_error("CreateSurfaceFromHostNative");
+  }
+  slot->surface = surface;
+  return surface;
+}
+
+HostSurfacePoolStats HostSurfacePool::stats() {
+  std::lock_guard lock{mutex};
+  return stats_;
+}
+
+void HostSurfacePool::OnSurfaceDataRelease(amf::AMFSurface *surface) {
+  {
+    std::lock_guard lock{mutex};
+    const auto slot{std::find_if(
+        slots.begin(), slots.end(),
+        [=](const auto &slot) { return slot.surface == surface; })};
+    ASSERT_(slot != slots.end());
+    slot->surface = nullptr;
+    slot->in_use = false;
+    --in_use;
+  }
+  released.notify_one();
+}
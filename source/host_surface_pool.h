@@ -0,0 +1,91 @@
+#pragma once
+
+#include <AMF/core/Context.h>
+#include <AMF/core/Surface.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Memory layout of a host surface whose planes follow each other in one
+// allocation as CreateSurfaceFromHostNative expects.
+struct HostSurfaceLayout {
+  // Bytes per row of the first plane. Chroma planes of planar formats use
+  // half of it.
+  int32_t h_pitch;
+  // Rows of the first plane including padding.
+  int32_t v_pitch;
+  size_t size;
+};
+
+HostSurfaceLayout host_surface_layout(amf::AMF_SURFACE_FORMAT, int32_t width,
+                                      int32_t height);
+
+// Counters describing how well the pool works. Copied out by stats().
+struct HostSurfacePoolStats {
+  // Surfaces handed out from pool memory.
+  uint64_t hits;
+  // Requests that found the pool exhausted even after waiting.
+  uint64_t misses;
+  // Requests that had to wait for a surface to be released.
+  uint64_t waits;
+  // Largest number of surfaces in use at the same time.
+  size_t high_water_mark;
+};
+
+// Host memory for CPU encoding that is allocated once and reused for every
+// frame instead of allocating a new surface each time. Pool memory is wrapped
+// into a surface with CreateSurfaceFromHostNative and returns to the pool when
+// AMF releases the surface, like TextureEncoder does with its textures.
+class HostSurfacePool : private amf::AMFSurfaceObserver {
+  struct Free {
+    void operator()(uint8_t *) const noexcept;
+  };
+  struct Slot {
+    std::unique_ptr<uint8_t, Free> memory;
+    // Set while AMF uses the slot. Unset in OnSurfaceDataRelease.
+    amf::AMFSurface *surface;
+    bool in_use;
+  };
+
+  amf::AMFContextPtr amf_context;
+  amf::AMF_SURFACE_FORMAT format;
+  int32_t width;
+  int32_t height;
+  HostSurfaceLayout layout;
+  std::chrono::milliseconds wait_timeout;
+
+  // AMF may release surfaces from its own threads.
+  std::mutex mutex;
+  std::condition_variable released;
+  std::vector<Slot> slots;
+  size_t in_use{0};
+  HostSurfacePoolStats stats_{};
+
+  // From AMFSurfaceObserver. Marks the slot as unused.
+  void OnSurfaceDataRelease(amf::AMFSurface *) override;
+
+public:
+  // Allocates capacity surfaces up front. When all are in use acquire waits up
+  // to wait_timeout for one to be released.
+  HostSurfacePool(amf::AMFContextPtr, amf::AMF_SURFACE_FORMAT, int32_t width,
+                  int32_t height, size_t capacity,
+                  std::chrono::milliseconds wait_timeout);
+  ~HostSurfacePool() noexcept;
+
+  // Delete moving because it would invalidate the surface observer pointer to
+  // this. Delete copying because surfaces point into our memory.
+  HostSurfacePool(const HostSurfacePool &) = delete;
+  HostSurfacePool(HostSurfacePool &&) = delete;
+  HostSurfacePool &operator=(const HostSurfacePool &) = delete;
+  HostSurfacePool &operator=(HostSurfacePool &&) = delete;
+
+  // Returns nullptr if the pool stayed exhausted for the whole wait timeout.
+  // Must outlive the returned surface.
+  amf::AMFSurfacePtr acquire();
+  HostSurfacePoolStats stats();
+};
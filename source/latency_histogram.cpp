@@ -0,0 +1,61 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+
+// Values below 4 get one bucket each. Above that every power of two is split
+// into four buckets.
+size_t bucket_index(uint64_t value) noexcept {
+  if (value < 4) {
+    return static_cast<size_t>(value);
+  }
+  const auto exponent{static_cast<size_t>(std::bit_width(value) - 1)};
+  const auto sub{static_cast<size_t>((value >> (exponent - 2)) & 3)};
+  return 4 * (exponent - 1) + sub;
+}
+
+uint64_t bucket_upper_bound(size_t index) noexcept {
+  if (index < 4) {
+    return index;
+  }
+  const auto exponent{index / 4 + 1};
+  const auto sub{index % 4};
+  const auto lower{static_cast<uint64_t>(4 + sub) << (exponent - 2)};
+  return lower + (uint64_t{1} << (exponent - 2)) - 1;
+}
+
+} // namespace
+
+void LatencyHistogram::record(std::chrono::microseconds duration) noexcept {
+  const auto value{
+      static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0))};
+  ++buckets[std::min(bucket_index(value), bucket_count - 1)];
+  ++count_;
+}
+
+std::chrono::microseconds
+LatencyHistogram::percentile(double percent) const noexcept {
+  if (count_ == 0) {
+    return {};
+  }
+  const auto rank{static_cast<uint64_t>(
+      std::ceil(std::clamp(percent, 0.0, 100.0) / 100 * count_))};
+  uint64_t seen{0};
+  for (size_t i{0}; i < bucket_count; ++i) {
+    seen += buckets[i];
+    if (seen >= std::max<uint64_t>(rank, 1)) {
+      return std::chrono::microseconds{bucket_upper_bound(i)};
+    }
+  }
+  return std::chrono::microseconds{bucket_upper_bound(bucket_count - 1)};
+}
+
+uint64_t LatencyHistogram::count() const noexcept { return count_; }
+
+void LatencyHistogram::clear() noexcept {
+  buckets.fill(0);
+  count_ = 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Histogram of durations with four buckets per power of two so that recording
+// is constant time and percentiles are accurate to about 25%.
+class LatencyHistogram {
+  static constexpr size_t bucket_count{160};
+  std::array<uint64_t, bucket_count> buckets{};
+  uint64_t count_{0};
+
+public:
+  void record(std::chrono::microseconds) noexcept;
+  // Upper bound of the bucket containing the percentile in [0, 100]. 0 when
+  // empty.
+  std::chrono::microseconds percentile(double) const noexcept;
+  uint64_t count() const noexcept;
+  void clear() noexcept;
+};
@@ -0,0 +1,139 @@
+#include "log_sink.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace log_sink_detail {
+
+// Slot of a bounded multi producer queue. The sequence tells producers and
+// the consumer whose turn it is: equal to the position when free, one more
+// when published.
+struct LogRecord {
+  std::atomic<size_t> sequence;
+  int level;
+  size_t size;
+  char text[text_capacity];
+};
+
+} // namespace log_sink_detail
+
+namespace {
+
+using log_sink_detail::LogRecord;
+
+constexpr size_t record_count{1024};
+static_assert((record_count & (record_count - 1)) == 0);
+constexpr std::chrono::milliseconds poll_interval{10};
+
+std::array<LogRecord, record_count> records;
+alignas(64) std::atomic<size_t> enqueue_position{0};
+alignas(64) size_t dequeue_position{0};
+std::atomic<size_t> dropped{0};
+std::atomic<bool> running{false};
+
+std::mutex stop_mutex;
+std::condition_variable stop_condition;
+bool stop_requested{false};
+std::thread sink_thread;
+
+// Consumer only. Passes everything published so far to OBS.
+void drain() noexcept {
+  for (;;) {
+    auto &record{records[dequeue_position & (record_count - 1)]};
+    if (record.sequence.load(std::memory_order_acquire) !=
+        dequeue_position + 1) {
+      break;
+    }
+    blog(record.level, "amftest: %.*s", static_cast<int>(record.size),
+         record.text);
+    record.sequence.store(dequeue_position + record_count,
+                          std::memory_order_release);
+    ++dequeue_position;
+  }
+  if (const auto count{dropped.exchange(0, std::memory_order_relaxed)}) {
+    log(LOG_WARNING, "dropped {} log messages", count);
+  }
+}
+
+void run() noexcept {
+  std::unique_lock lock{stop_mutex};
+  while (!stop_condition.wait_for(lock, poll_interval,
+                                  [] { return stop_requested; })) {
+    drain();
+  }
+}
+
+} // namespace
+
+namespace log_sink_detail {
+
+bool log_sink_running() noexcept {
+  return running.load(std::memory_order_acquire);
+}
+
+LogRecord *claim_log_record() noexcept {
+  if (!running.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  auto position{enqueue_position.load(std::memory_order_relaxed)};
+  for (;;) {
+    auto &record{records[position & (record_count - 1)]};
+    const auto sequence{record.sequence.load(std::memory_order_acquire)};
+    if (sequence == position) {
+      if (enqueue_position.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+        return &record;
+      }
+    } else if (sequence < position) {
+      // The consumer has not freed this record yet.
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = enqueue_position.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+char *log_record_text(LogRecord &record) noexcept { return record.text; }
+
+void publish_log_record(LogRecord &record, int log_level,
+                        size_t size) noexcept {
+  record.level = log_level;
+  record.size = size;
+  // The claimed sequence equals the position so one more marks it published.
+  record.sequence.store(record.sequence.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+}
+
+} // namespace log_sink_detail
+
+void start_log_sink() {
+  for (size_t i{0}; i < record_count; ++i) {
+    records[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  enqueue_position = 0;
+  dequeue_position = 0;
+  stop_requested = false;
+  sink_thread = std::thread{run};
+  running.store(true, std::memory_order_release);
+}
+
+void stop_log_sink() noexcept {
+  if (!sink_thread.joinable()) {
+    return;
+  }
+  // Producers that already claimed a record still publish it. They are done
+  // by the time OBS unloads the module because all encoders are destroyed.
+  running.store(false, std::memory_order_release);
+  {
+    std::scoped_lock lock{stop_mutex};
+    stop_requested = true;
+  }
+  stop_condition.notify_one();
+  sink_thread.join();
+  drain();
+}
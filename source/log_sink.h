@@ -0,0 +1,63 @@
+#pragma once
+
+#include "util.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+
+// Formats log messages on the calling thread into a fixed ring of records and
+// passes them to OBS on a background thread. blog takes a global lock and may
+// write to a file, which should not happen on the encode thread. Messages are
+// truncated to the record size and dropped when the ring is full.
+
+void start_log_sink();
+void stop_log_sink() noexcept;
+
+namespace log_sink_detail {
+
+struct LogRecord;
+
+constexpr size_t text_capacity{256};
+
+bool log_sink_running() noexcept;
+// A record for writing or null when the ring is full or the sink is stopped.
+// A full ring counts the message as dropped.
+LogRecord *claim_log_record() noexcept;
+char *log_record_text(LogRecord &) noexcept;
+void publish_log_record(LogRecord &, int log_level, size_t size) noexcept;
+
+} // namespace log_sink_detail
+
+// Like log but does not block on OBS. Falls back to log when the sink is not
+// running.
+template <typename... T>
+void log_async(int log_level, fmt::format_string<T...> fmt, T &&...args) {
+  using namespace log_sink_detail;
+  if (!log_enabled(log_level)) {
+    return;
+  }
+  if (!log_sink_running()) {
+    log(log_level, fmt, std::forward<T>(args)...);
+    return;
+  }
+  auto *const record{claim_log_record()};
+  if (!record) {
+    return;
+  }
+  // The claimed record must be published even when formatting fails.
+  // Otherwise the sink would wait for it forever.
+  size_t size;
+  try {
+    size = fmt::format_to_n(log_record_text(*record), text_capacity, fmt,
+                            std::forward<T>(args)...)
+               .size;
+  } catch (const std::exception &e) {
+    size = fmt::format_to_n(log_record_text(*record), text_capacity,
+                            "log formatting failed: {}", e.what())
+               .size;
+  }
+  publish_log_record(*record, log_level, std::min(size, text_capacity));
+}
@@ -0,0 +1,226 @@
+#include "options.h"
+
+namespace {
+
+const EnumOption output_mode_option{
+    "output mode",
+    "Output Mode",
+    {{static_cast<int>(OutputMode::Poll), "Poll Once Per Frame"},
+     {static_cast<int>(OutputMode::DrainThread), "Drain Thread"},
+     {static_cast<int>(OutputMode::BoundedWait), "Submit Then Wait"}},
+    0};
+const IntOption output_queue_capacity_option{
+    "output queue capacity", "Drain Thread Packet Queue Capacity", 2, 256, 16};
+const IntOption output_wait_budget_option{
+    "output wait budget", "Submit Then Wait Budget (microseconds)", 100,
+    100000, 10000};
+const IntOption host_surface_pool_size_option{
+    "host surface pool size", "CPU Encoding Surface Pool Size", 0, 64, 0};
+const IntOption host_surface_pool_wait_option{
+    "host surface pool wait", "CPU Encoding Surface Pool Wait (milliseconds)",
+    0, 1000, 10};
+const IntOption copy_threads_option{"copy threads", "CPU Encoding Copy Threads",
+                                    1, 16, 1};
+const IntOption parallel_copy_threshold_option{
+    "parallel copy threshold", "CPU Encoding Parallel Copy Threshold (KiB)", 0,
+    1024 * 1024, 4 * 1024};
+const BoolOption zero_copy_option{"zero copy",
+                                  "CPU Encoding Zero Copy Upload", false};
+const EnumOption packet_output_option{
+    "packet output",
+    "Packet Output",
+    {{static_cast<int>(PacketOutput::Copy), "Copy"},
+     {static_cast<int>(PacketOutput::Retain), "Zero Copy"}},
+    0};
+const IntOption pending_input_capacity_option{
+    "pending input capacity", "Frames Held While Encoder Is Busy", 0, 16, 4};
+const EnumOption drop_policy_option{
+    "drop policy",
+    "Frame To Drop When Encoder Is Busy",
+    {{static_cast<int>(DropPolicy::Oldest), "Oldest"},
+     {static_cast<int>(DropPolicy::Newest), "Newest"},
+     {static_cast<int>(DropPolicy::Interior), "Middle Of Queue"}},
+    0};
+const EnumOption extra_data_format_option{
+    "extra data format",
+    "Extra Data Format",
+    {{static_cast<int>(ExtraDataFormat::AnnexB), "Annex B"},
+     {static_cast<int>(ExtraDataFormat::ConfigurationRecord),
+      "avcC / hvcC"}},
+    0};
+const BoolOption strip_filler_data_option{
+    "strip filler data", "Remove Filler Data From Packets", false};
+const IntOption shared_texture_cache_size_option{
+    "shared texture cache size", "Texture Encoding Shared Texture Cache Size",
+    1, 64, 16};
+const IntOption texture_ring_size_option{
+    "texture ring size", "Texture Encoding Ring Size (0 for automatic)", 0, 64,
+    0};
+const IntOption texture_ring_wait_option{
+    "texture ring wait", "Texture Encoding Ring Wait (milliseconds)", 0, 1000,
+    10};
+const IntOption texture_acquire_timeout_option{
+    "texture acquire timeout",
+    "Texture Encoding Acquire Timeout (milliseconds, 0 for none)", 0, 10000,
+    0};
+const EnumOption texture_acquire_timeout_action_option{
+    "texture acquire timeout action",
+    "Texture Encoding Acquire Timeout Action",
+    {{static_cast<int>(AcquireTimeoutAction::Skip), "Skip Frame"},
+     {static_cast<int>(AcquireTimeoutAction::Repeat), "Repeat Previous Frame"}},
+    0};
+const BoolOption adaptive_bitrate_option{"adaptive bitrate",
+                                         "Adaptive Bitrate", false};
+const IntOption adaptive_bitrate_min_option{
+    "adaptive bitrate min", "Adaptive Bitrate Minimum (kbps)", 100, 1000000,
+    1000};
+const IntOption adaptive_bitrate_max_option{
+    "adaptive bitrate max",
+    "Adaptive Bitrate Maximum (kbps, 0 for target bit rate)", 0, 1000000, 0};
+const IntOption adaptive_bitrate_increase_option{
+    "adaptive bitrate increase", "Adaptive Bitrate Increase (kbps)", 1, 100000,
+    250};
+const IntOption adaptive_bitrate_decrease_option{
+    "adaptive bitrate decrease", "Adaptive Bitrate Decrease (percent kept)", 10,
+    99, 80};
+const IntOption adaptive_bitrate_window_option{
+    "adaptive bitrate window", "Adaptive Bitrate Window (milliseconds)", 100,
+    10000, 1000};
+const IntOption adaptive_bitrate_input_full_option{
+    "adaptive bitrate input full",
+    "Adaptive Bitrate Congested When Encoder Busy (percent of frames)", 1, 100,
+    10};
+const IntOption adaptive_bitrate_overshoot_option{
+    "adaptive bitrate overshoot",
+    "Adaptive Bitrate Congested At Output Above Target (percent)", 100, 1000,
+    150};
+const BoolOption overload_governor_option{
+    "overload governor", "Lower Quality When Encoder Is Overloaded", false};
+const IntOption overload_window_option{
+    "overload window", "Overload Window (milliseconds)", 100, 10000, 1000};
+const IntOption overload_input_full_option{
+    "overload input full",
+    "Overloaded When Encoder Busy (percent of frames)", 1, 100, 5};
+const IntOption overload_latency_option{
+    "overload latency", "Overloaded At Latency (milliseconds)", 1, 10000, 100};
+const IntOption overload_queue_option{
+    "overload queue", "Overloaded At Waiting Frames", 0, 16, 1};
+const IntOption overload_recover_option{
+    "overload recover", "Calm Windows Before Raising Quality", 1, 1000, 10};
+const BoolOption telemetry_option{
+    "telemetry", "Collect Per Frame Encoder Statistics", false};
+const BoolOption telemetry_quality_option{
+    "telemetry quality", "Also Measure PSNR And SSIM Per Frame", false};
+const PathOption telemetry_file_option{
+    "telemetry file", "Per Frame Statistics File (CSV)", "CSV (*.csv)"};
+const IntOption stats_interval_option{
+    "stats interval", "Stats Log Interval (seconds, 0 for end only)", 0, 3600,
+    0};
+const PathOption stats_file_option{"stats file", "Stats File (JSON Lines)",
+                                   "JSON Lines (*.jsonl)"};
+
+const Option *const settings_[] = {
+    &output_mode_option,
+    &output_queue_capacity_option,
+    &output_wait_budget_option,
+    &host_surface_pool_size_option,
+    &host_surface_pool_wait_option,
+    &copy_threads_option,
+    &parallel_copy_threshold_option,
+    &zero_copy_option,
+    &packet_output_option,
+    &pending_input_capacity_option,
+    &drop_policy_option,
+    &extra_data_format_option,
+    &strip_filler_data_option,
+    &shared_texture_cache_size_option,
+    &texture_ring_size_option,
+    &texture_ring_wait_option,
+    &texture_acquire_timeout_option,
+    &texture_acquire_timeout_action_option,
+    &adaptive_bitrate_option,
+    &adaptive_bitrate_min_option,
+    &adaptive_bitrate_max_option,
+    &adaptive_bitrate_increase_option,
+    &adaptive_bitrate_decrease_option,
+    &adaptive_bitrate_window_option,
+    &adaptive_bitrate_input_full_option,
+    &adaptive_bitrate_overshoot_option,
+    &overload_governor_option,
+    &overload_window_option,
+    &overload_input_full_option,
+    &overload_latency_option,
+    &overload_queue_option,
+    &overload_recover_option,
+    &telemetry_option,
+    &telemetry_quality_option,
+    &telemetry_file_option,
+    &stats_interval_option,
+    &stats_file_option,
+};
+
+int64_t kbps(const IntOption &option, obs_data &data) {
+  return static_cast<int64_t>(option.get(data)) * 1000;
+}
+
+double percent(const IntOption &option, obs_data &data) {
+  return option.get(data) / 100.0;
+}
+
+} // namespace
+
+Options::Options(obs_data &data)
+    : output_mode{static_cast<OutputMode>(output_mode_option.get(data))},
+      output_queue_capacity{
+          static_cast<size_t>(output_queue_capacity_option.get(data))},
+      output_wait_budget{output_wait_budget_option.get(data)},
+      host_surface_pool_size{
+          static_cast<size_t>(host_surface_pool_size_option.get(data))},
+      host_surface_pool_wait{host_surface_pool_wait_option.get(data)},
+      copy_threads{static_cast<size_t>(copy_threads_option.get(data))},
+      parallel_copy_threshold{
+          static_cast<size_t>(parallel_copy_threshold_option.get(data)) *
+          1024},
+      zero_copy{zero_copy_option.get(data)},
+      packet_output{
+          static_cast<PacketOutput>(packet_output_option.get(data))},
+      pending_input_capacity{
+          static_cast<size_t>(pending_input_capacity_option.get(data))},
+      drop_policy{static_cast<DropPolicy>(drop_policy_option.get(data))},
+      extra_data_format{static_cast<ExtraDataFormat>(
+          extra_data_format_option.get(data))},
+      strip_filler_data{strip_filler_data_option.get(data)},
+      shared_texture_cache_size{
+          static_cast<size_t>(shared_texture_cache_size_option.get(data))},
+      texture_ring_size{
+          static_cast<size_t>(texture_ring_size_option.get(data))},
+      texture_ring_wait{texture_ring_wait_option.get(data)},
+      texture_acquire_timeout{texture_acquire_timeout_option.get(data)},
+      texture_acquire_timeout_action{static_cast<AcquireTimeoutAction>(
+          texture_acquire_timeout_action_option.get(data))},
+      adaptive_bitrate{adaptive_bitrate_option.get(data)},
+      adaptive_bitrate_min{kbps(adaptive_bitrate_min_option, data)},
+      adaptive_bitrate_max{kbps(adaptive_bitrate_max_option, data)},
+      adaptive_bitrate_increase{kbps(adaptive_bitrate_increase_option, data)},
+      adaptive_bitrate_decrease{
+          percent(adaptive_bitrate_decrease_option, data)},
+      adaptive_bitrate_window{adaptive_bitrate_window_option.get(data)},
+      adaptive_bitrate_input_full_threshold{
+          percent(adaptive_bitrate_input_full_option, data)},
+      adaptive_bitrate_overshoot_threshold{
+          percent(adaptive_bitrate_overshoot_option, data)},
+      overload_governor{overload_governor_option.get(data)},
+      overload_window{overload_window_option.get(data)},
+      overload_input_full_threshold{percent(overload_input_full_option, data)},
+      overload_latency_threshold{overload_latency_option.get(data)},
+      overload_queue_threshold{
+          static_cast<size_t>(overload_queue_option.get(data))},
+      overload_recover_windows{
+          static_cast<uint32_t>(overload_recover_option.get(data))},
+      telemetry{telemetry_option.get(data)},
+      telemetry_quality{telemetry_quality_option.get(data)},
+      telemetry_file{telemetry_file_option.get(data)},
+      stats_interval{stats_interval_option.get(data)},
+      stats_file{stats_file_option.get(data)} {}
+
+const std::span<const Option *const> Options::settings{settings_};
@@ -0,0 +1,145 @@
+#pragma once
+
+// Options change how the plugin drives the encoder as opposed to the per codec
+// settings which are forwarded to AMF as properties.
+
+#include "settings.h"
+
+#include <obs-module.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// How encoder output is retrieved.
+enum class OutputMode {
+  // Poll the encoder once per call to encode.
+  Poll,
+  // A dedicated thread polls the encoder and queues finished packets.
+  DrainThread,
+  // Submit the frame and then wait a bounded time for its packet.
+  BoundedWait,
+};
+
+// How encoded packets are handed to OBS.
+enum class PacketOutput {
+  // Copy the bitstream into a buffer owned by the encoder.
+  Copy,
+  // Keep the AMF buffer alive and let OBS read it directly.
+  Retain,
+};
+
+// Which frame to drop when the pending input queue overflows.
+enum class DropPolicy {
+  // The frame that has waited longest.
+  Oldest,
+  // The frame that was just encoded by OBS.
+  Newest,
+  // A frame from the middle of the queue so that the frames on either side of
+  // the gap are still encoded.
+  Interior,
+};
+
+// What to do when OBS does not release a frame texture in time.
+enum class AcquireTimeoutAction {
+  Skip,
+  // Encode the previous frame again so the output keeps its frame rate.
+  Repeat,
+};
+
+// What get_extra_data returns.
+enum class ExtraDataFormat {
+  // Parameter sets with start codes like the packets. Expected by the outputs
+  // that come with OBS.
+  AnnexB,
+  // avcC or hvcC record for outputs that hand it to an MP4 or Matroska muxer
+  // directly.
+  ConfigurationRecord,
+};
+
+struct Options {
+  OutputMode output_mode{OutputMode::Poll};
+  // Maximum number of finished packets held by the drain thread.
+  size_t output_queue_capacity{16};
+  // How long OutputMode::BoundedWait waits for output after submitting.
+  std::chrono::microseconds output_wait_budget{10000};
+  // Number of reusable host surfaces for CPU encoding. 0 allocates a new
+  // surface for every frame.
+  size_t host_surface_pool_size{0};
+  // How long to wait for a pooled surface before allocating one.
+  std::chrono::milliseconds host_surface_pool_wait{10};
+  // Threads used to copy CPU frames into surfaces including the OBS thread.
+  // More threads compete with OBS for the CPU and memory bandwidth and rarely
+  // make the copy much faster. Measure with tests/copy_threads_benchmark.cpp.
+  size_t copy_threads{1};
+  // Frames smaller than this are copied by the OBS thread alone because
+  // waking up the workers costs more than it saves.
+  size_t parallel_copy_threshold{4 * 1024 * 1024};
+  // Upload CPU frames from OBS memory without copying them first when their
+  // layout allows it.
+  bool zero_copy{false};
+  PacketOutput packet_output{PacketOutput::Copy};
+  // Frames held back while the encoder reports that its input is full. 0 drops
+  // them immediately.
+  size_t pending_input_capacity{4};
+  DropPolicy drop_policy{DropPolicy::Oldest};
+  ExtraDataFormat extra_data_format{ExtraDataFormat::AnnexB};
+  // Remove the filler data that constant bitrate pads packets with. Saves
+  // space in recordings but every output of the encoder loses it, so a
+  // stream from the same encoder is no longer strictly constant bitrate.
+  bool strip_filler_data{false};
+  // Opened OBS shared textures kept for texture encoding.
+  size_t shared_texture_cache_size{16};
+  // Textures that frames are copied into for texture encoding. 0 derives it
+  // from the encoder's pipeline depth.
+  size_t texture_ring_size{0};
+  // How long to wait for a texture when all are in use before skipping the
+  // frame.
+  std::chrono::milliseconds texture_ring_wait{10};
+  // How long to wait for OBS to release a frame texture. 0 waits forever.
+  std::chrono::milliseconds texture_acquire_timeout{0};
+  AcquireTimeoutAction texture_acquire_timeout_action{
+      AcquireTimeoutAction::Skip};
+  // Adapt the target bitrate to congestion within the bounds below. Has no
+  // effect with constant QP.
+  bool adaptive_bitrate{false};
+  // Bits per second. 0 for the maximum uses the configured target bitrate.
+  int64_t adaptive_bitrate_min{1000000};
+  int64_t adaptive_bitrate_max{0};
+  // Bits per second added after each window without congestion.
+  int64_t adaptive_bitrate_increase{250000};
+  // Factor applied after a congested window.
+  double adaptive_bitrate_decrease{0.8};
+  std::chrono::milliseconds adaptive_bitrate_window{1000};
+  // Fractions that make a window congested. See BitrateControllerConfig.
+  double adaptive_bitrate_input_full_threshold{0.1};
+  double adaptive_bitrate_overshoot_threshold{1.5};
+  // Lower the quality preset and motion estimation precision while the
+  // encoder cannot keep up.
+  bool overload_governor{false};
+  std::chrono::milliseconds overload_window{1000};
+  // What makes a window overloaded. See OverloadGovernorConfig.
+  double overload_input_full_threshold{0.05};
+  std::chrono::milliseconds overload_latency_threshold{100};
+  size_t overload_queue_threshold{1};
+  uint32_t overload_recover_windows{10};
+  // Ask the encoder for per frame statistics like QP and pixel counts.
+  bool telemetry{false};
+  // Also ask for PSNR and SSIM, which costs encoder time.
+  bool telemetry_quality{false};
+  // When set, the per frame statistics are appended to this CSV file.
+  std::string telemetry_file;
+  // How often to log a stats summary. 0 only logs when the encoder is
+  // destroyed.
+  std::chrono::seconds stats_interval{0};
+  // When set, every stats summary is also appended to this JSON lines file.
+  std::string stats_file;
+
+  Options() noexcept = default;
+  explicit Options(obs_data &);
+
+  // Registered with OBS in addition to the codec specific settings.
+  static const std::span<const Option *const> settings;
+};
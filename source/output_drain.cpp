@@ -0,0 +1,62 @@
+#include "output_drain.h"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+// How long to wait before polling again when the encoder has no output and
+// does not wait by itself, or when the queue is full. The encoder produces at
+// most one packet per frame so this is short compared to a frame interval.
+constexpr std::chrono::microseconds poll_interval{500};
+
+} // namespace
+
+OutputDrain::OutputDrain(amf::AMFComponentPtr encoder_, size_t capacity,
+                         bool query_blocks_)
+    : encoder{encoder_}, queue{capacity}, query_blocks{query_blocks_},
+      thread{[this](std::stop_token stop) { run(stop); }} {}
+
+void OutputDrain::run(std::stop_token stop) noexcept {
+  amf::AMFDataPtr pending;
+  while (!stop.stop_requested()) {
+    if (!pending) {
+      const auto result{encoder->QueryOutput(&pending)};
+      if (result == AMF_EOF) {
+        return;
+      } else if (result == AMF_REPEAT) {
+        repeats.fetch_add(1, std::memory_order_relaxed);
+      } else if (result != AMF_OK) {
+        error = fmt::format("QueryOutput: {}", result);
+        failed.store(true, std::memory_order_release);
+        return;
+      }
+    }
+    // When the queue is full we hold on to the output which stops us from
+    // querying more. The encoder then applies backpressure through
+    // AMF_INPUT_FULL like it does without the drain thread.
+    if (pending && queue.push(std::move(pending))) {
+      pending = nullptr;
+    } else if (pending || !query_blocks) {
+      timer.sleep(poll_interval);
+    }
+  }
+}
+
+amf::AMFDataPtr OutputDrain::pop() {
+  if (auto data = queue.pop()) {
+    return *data;
+  }
+  if (failed.load(std::memory_order_acquire)) {
+    throw std::runtime_error(fmt::format("OutputDrain: {}", error));
+  }
+  return nullptr;
+}
+
+size_t OutputDrain::queued() const noexcept { return queue.size(); }
+
+uint64_t OutputDrain::repeat_count() const noexcept {
+  return repeats.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "spsc_queue.h"
+#include "waitable_timer.h"
+
+#include <AMF/components/Component.h>
+#include <AMF/core/Data.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Polls an AMF component for output on a dedicated thread and queues the
+// results. This makes packets available as soon as the encoder finishes them
+// instead of one call to encode later and keeps the encoder's output queue from
+// backing up when it produces packets in bursts.
+//
+// AMF allows SubmitInput and QueryOutput to be called from different threads.
+// The AMF samples use the same split.
+//
+// OBS takes one packet per call to encode, so a burst of packets leaves the
+// queue one per frame. The encoder produces one packet per frame on average so
+// the queue drains again, and when it is full the encoder reports that its
+// input is full.
+class OutputDrain {
+  amf::AMFComponentPtr encoder;
+  SpscQueue<amf::AMFDataPtr> queue;
+  // QueryOutput waits for output by itself because the encoder's query timeout
+  // is set. Otherwise we sleep between polls.
+  bool query_blocks;
+  WaitableTimer timer;
+  // Set by the drain thread before it exits because of an error. error is
+  // written before failed is set.
+  std::atomic<bool> failed{false};
+  std::string error;
+  // QueryOutput returned AMF_REPEAT. Only written by the drain thread.
+  std::atomic<uint64_t> repeats{0};
+  // Declared last so that the thread is joined before the above is destroyed.
+  std::jthread thread;
+
+  void run(std::stop_token) noexcept;
+
+public:
+  // Query timeout for the encoder to use with the drain thread. Output is
+  // returned as soon as it is ready so this only bounds how long stopping
+  // takes.
+  static constexpr std::chrono::milliseconds query_timeout{10};
+
+  OutputDrain(amf::AMFComponentPtr, size_t capacity, bool query_blocks);
+
+  // Delete moving and copying because the thread refers to this.
+  OutputDrain(const OutputDrain &) = delete;
+  OutputDrain(OutputDrain &&) = delete;
+  OutputDrain &operator=(const OutputDrain &) = delete;
+  OutputDrain &operator=(OutputDrain &&) = delete;
+
+  // Returns the oldest finished output or nullptr if there is none. Throws if
+  // the drain thread stopped because of an error. Must only be called from one
+  // thread.
+  amf::AMFDataPtr pop();
+  // Number of finished outputs waiting to be popped.
+  size_t queued() const noexcept;
+  uint64_t repeat_count() const noexcept;
+};
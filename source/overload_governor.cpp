@@ -0,0 +1,65 @@
+#include "overload_governor.h"
+
+#include <algorithm>
+
+OverloadGovernor::OverloadGovernor(const OverloadGovernorConfig &config_,
+                                   uint32_t max_level_) noexcept
+    : config{config_}, max_level{max_level_} {
+  config.window_frames = std::max<uint32_t>(config.window_frames, 1);
+}
+
+std::optional<uint32_t> OverloadGovernor::observe(
+    uint64_t input_full_total, std::optional<std::chrono::microseconds> latency,
+    size_t queue) noexcept {
+  if (frames == 0) {
+    // The total is only known from the first observation on.
+    frames = 1;
+    input_full_start = input_full_total;
+    return std::nullopt;
+  }
+  if (latency) {
+    latency_sum += *latency;
+    ++latency_count;
+  }
+  max_queue = std::max(max_queue, queue);
+  if (++frames <= config.window_frames) {
+    return std::nullopt;
+  }
+
+  const auto input_full{input_full_total - input_full_start};
+  const auto mean_latency{latency_count > 0 ? latency_sum / latency_count
+                                            : std::chrono::microseconds{0}};
+  const bool overloaded{
+      static_cast<double>(input_full) >
+          config.input_full_threshold * config.window_frames ||
+      mean_latency > config.latency_threshold ||
+      max_queue > config.queue_threshold};
+  const bool calm{input_full == 0 && max_queue == 0 &&
+                  mean_latency * 2 < config.latency_threshold};
+
+  // The observation that closes this window opens the next one.
+  frames = 1;
+  input_full_start = input_full_total;
+  latency_sum = std::chrono::microseconds{0};
+  latency_count = 0;
+  max_queue = 0;
+
+  const auto previous{level};
+  if (overloaded) {
+    calm_windows = 0;
+    level = std::min(level + 1, max_level);
+  } else if (calm && level > 0) {
+    if (++calm_windows >= config.recover_windows) {
+      calm_windows = 0;
+      --level;
+    }
+  } else {
+    calm_windows = 0;
+  }
+  if (level == previous) {
+    return std::nullopt;
+  }
+  return level;
+}
+
+uint32_t OverloadGovernor::current_level() const noexcept { return level; }
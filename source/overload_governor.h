@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+struct OverloadGovernorConfig {
+  // Frames per decision.
+  uint32_t window_frames;
+  // A window is overloaded when more than this fraction of its frames found
+  // the encoder input full,
+  double input_full_threshold;
+  // or the mean submit to output latency exceeded this,
+  std::chrono::microseconds latency_threshold;
+  // or frames waiting for the encoder exceeded this.
+  size_t queue_threshold;
+  // Consecutive calm windows before stepping back up. A window is calm when no
+  // frame found the input full, nothing waited and the latency stayed below
+  // half the threshold.
+  uint32_t recover_windows;
+};
+
+// Decides how many levels the encoder's quality has to be lowered so that it
+// keeps up. Steps down one level after every overloaded window and up one
+// level after recover_windows calm windows. Level 0 is the user's
+// configuration.
+//
+// Only depends on the sequence of observations like BitrateController.
+class OverloadGovernor {
+  OverloadGovernorConfig config;
+  uint32_t max_level;
+  uint32_t level{0};
+
+  uint32_t frames{0};
+  uint64_t input_full_start{0};
+  std::chrono::microseconds latency_sum{0};
+  uint32_t latency_count{0};
+  size_t max_queue{0};
+  uint32_t calm_windows{0};
+
+public:
+  OverloadGovernor(const OverloadGovernorConfig &, uint32_t max_level) noexcept;
+
+  // Call once per frame with the running total of frames that found the
+  // encoder input full, the latency of the packet received for this frame and
+  // the frames waiting for the encoder. Returns the new level when it changed.
+  std::optional<uint32_t>
+  observe(uint64_t input_full_total,
+          std::optional<std::chrono::microseconds> latency,
+          size_t queue) noexcept;
+
+  uint32_t current_level() const noexcept;
+};
@@ -0,0 +1,231 @@
+#include "plane_copy.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PLANE_COPY_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// MSVC lets us use any intrinsic in any function. GCC and Clang need to be told
+// which functions may use instructions beyond the baseline.
+#if defined(PLANE_COPY_X86) && defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+using Kernel = void (*)(const PlaneCopy &, bool streaming) noexcept;
+
+void copy_scalar(const PlaneCopy &c, bool) noexcept {
+  if (c.dst_pitch == c.row_bytes && c.src_pitch == c.row_bytes) {
+    std::memcpy(c.dst, c.src, c.row_bytes * c.rows);
+    return;
+  }
+  for (size_t row{0}; row < c.rows; ++row) {
+    std::memcpy(c.dst + c.dst_pitch * row, c.src + c.src_pitch * row,
+                c.row_bytes);
+  }
+}
+
+#ifdef PLANE_COPY_X86
+
+// Bytes until p is aligned to alignment, limited to size.
+size_t head_bytes(const uint8_t *p, size_t alignment, size_t size) noexcept {
+  const auto misalignment{reinterpret_cast<uintptr_t>(p) & (alignment - 1)};
+  const auto head{misalignment == 0 ? 0 : alignment - misalignment};
+  return head < size ? head : size;
+}
+
+void copy_sse2(const PlaneCopy &c, bool streaming) noexcept {
+  for (size_t row{0}; row < c.rows; ++row) {
+    auto *dst{c.dst + c.dst_pitch * row};
+    const auto *src{c.src + c.src_pitch * row};
+    auto remaining{c.row_bytes};
+    // Streaming stores must be aligned so copy the unaligned head normally.
+    if (streaming) {
+      const auto head{head_bytes(dst, 16, remaining)};
+      std::memcpy(dst, src, head);
+      dst += head;
+      src += head;
+      remaining -= head;
+    }
+    for (; remaining >= 64; remaining -= 64, src += 64, dst += 64) {
+      const auto a{_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))};
+      const auto b{
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16))};
+      const auto c_{
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32))};
+      const auto d{
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 48))};
+      auto *const out{reinterpret_cast<__m128i *>(dst)};
+      if (streaming) {
+        _mm_stream_si128(out, a);
+        _mm_stream_si128(out + 1, b);
+        _mm_stream_si128(out + 2, c_);
+        _mm_stream_si128(out + 3, d);
+      } else {
+        _mm_storeu_si128(out, a);
+        _mm_storeu_si128(out + 1, b);
+        _mm_storeu_si128(out + 2, c_);
+        _mm_storeu_si128(out + 3, d);
+      }
+    }
+    std::memcpy(dst, src, remaining);
+  }
+  if (streaming) {
+    // Make the streaming stores visible before the encoder reads the surface.
+    _mm_sfence();
+  }
+}
+
+TARGET_AVX2 void copy_avx2(const PlaneCopy &c, bool streaming) noexcept {
+  for (size_t row{0}; row < c.rows; ++row) {
+    auto *dst{c.dst + c.dst_pitch * row};
+    const auto *src{c.src + c.src_pitch * row};
+    auto remaining{c.row_bytes};
+    if (streaming) {
+      const auto head{head_bytes(dst, 32, remaining)};
+      std::memcpy(dst, src, head);
+      dst += head;
+      src += head;
+      remaining -= head;
+    }
+    for (; remaining >= 128; remaining -= 128, src += 128, dst += 128) {
+      const auto *const in{reinterpret_cast<const __m256i *>(src)};
+      const auto a{_mm256_loadu_si256(in)};
+      const auto b{_mm256_loadu_si256(in + 1)};
+      const auto c_{_mm256_loadu_si256(in + 2)};
+      const auto d{_mm256_loadu_si256(in + 3)};
+      auto *const out{reinterpret_cast<__m256i *>(dst)};
+      if (streaming) {
+        _mm256_stream_si256(out, a);
+        _mm256_stream_si256(out + 1, b);
+        _mm256_stream_si256(out + 2, c_);
+        _mm256_stream_si256(out + 3, d);
+      } else {
+        _mm256_storeu_si256(out, a);
+        _mm256_storeu_si256(out + 1, b);
+        _mm256_storeu_si256(out + 2, c_);
+        _mm256_storeu_si256(out + 3, d);
+      }
+    }
+    for (; remaining >= 32; remaining -= 32, src += 32, dst += 32) {
+      const auto a{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src))};
+      if (streaming) {
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(dst), a);
+      } else {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), a);
+      }
+    }
+    std::memcpy(dst, src, remaining);
+  }
+  if (streaming) {
+    _mm_sfence();
+  }
+}
+
+bool cpu_has_avx2() noexcept {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  // OSXSAVE and AVX, and the OS saves the YMM registers.
+  const auto osxsave{(info[2] & (1 << 27)) != 0};
+  const auto avx{(info[2] & (1 << 28)) != 0};
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // PLANE_COPY_X86
+
+struct Dispatch {
+  Kernel kernel;
+  const char *name;
+};
+
+Dispatch select_kernel() noexcept {
+#ifdef PLANE_COPY_X86
+  if (cpu_has_avx2()) {
+    return {copy_avx2, "avx2"};
+  }
+  // SSE2 is part of x86-64.
+  return {copy_sse2, "sse2"};
+#else
+  return {copy_scalar, "scalar"};
+#endif
+}
+
+const Dispatch &dispatch() noexcept {
+  static const Dispatch selected{select_kernel()};
+  return selected;
+}
+
+size_t query_last_level_cache_size() noexcept {
+  // Used when the size cannot be determined. Typical for desktop CPUs.
+  constexpr size_t fallback{16 * 1024 * 1024};
+#ifdef _WIN32
+  DWORD length{0};
+  GetLogicalProcessorInformation(nullptr, &length);
+  if (length == 0) {
+    return fallback;
+  }
+  std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(
+      length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+  if (!GetLogicalProcessorInformation(infos.data(), &length)) {
+    return fallback;
+  }
+  size_t size{0};
+  BYTE level{0};
+  for (const auto &info : infos) {
+    if (info.Relationship == RelationCache && info.Cache.Level >= level) {
+      level = info.Cache.Level;
+      size = info.Cache.Size;
+    }
+  }
+  return size > 0 ? size : fallback;
+#else
+  const auto size{sysconf(_SC_LEVEL3_CACHE_SIZE)};
+  return size > 0 ? static_cast<size_t>(size) : fallback;
+#endif
+}
+
+} // namespace
+
+void copy_plane(const PlaneCopy &copy, bool streaming) noexcept {
+  // A single memcpy is hard to beat when there is no padding between rows.
+  if (!streaming && copy.dst_pitch == copy.row_bytes &&
+      copy.src_pitch == copy.row_bytes) {
+    copy_scalar(copy, false);
+    return;
+  }
+  dispatch().kernel(copy, streaming);
+}
+
+bool prefer_streaming_stores(size_t bytes) noexcept {
+  static const size_t last_level_cache_size{query_last_level_cache_size()};
+  return bytes > last_level_cache_size;
+}
+
+const char *plane_copy_kernel_name() noexcept { return dispatch().name; }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// One strided image plane copy. Only row_bytes of every row are copied so
+// padding at the end of source or destination rows is not touched.
+struct PlaneCopy {
+  uint8_t *dst;
+  size_t dst_pitch;
+  const uint8_t *src;
+  size_t src_pitch;
+  size_t row_bytes;
+  size_t rows;
+};
+
+// Copy with the fastest kernel the CPU supports (AVX2, SSE2 or memcpy).
+// Streaming uses non-temporal stores that bypass the cache. That is faster when
+// the destination is not read by the CPU again soon and the data would evict
+// everything else from the cache anyway.
+void copy_plane(const PlaneCopy &, bool streaming) noexcept;
+
+// Whether copying this many bytes should use streaming stores. True when the
+// copy does not fit into the last level cache.
+bool prefer_streaming_stores(size_t bytes) noexcept;
+
+// Name of the kernel copy_plane uses for logging.
+const char *plane_copy_kernel_name() noexcept;
@@ -2,10 +2,14 @@
 
 #include "encoder.h"
 #include "encoder_avc.h"
+#include "encoder_caps.h"
 #include "encoder_hevc.h"
 #include "gsl.h"
+#include "log_sink.h"
+#include "options.h"
 #include "settings.h"
 #include "util.h"
+#include "warm_up.h"
 
 #include <fmt/core.h>
 #include <obs-module.h>
@@ -51,6 +55,9 @@ template <EncoderPlugin ep, typename Encoder> void register_encoder() {
             for (const auto &setting : Encoder::settings) {
               setting->obs_default(*data);
             }
+            for (const auto &option : Options::settings) {
+              option->obs_default(*data);
+            }
           },
       .get_properties =
           [](auto) noexcept {
@@ -58,16 +65,35 @@ template <EncoderPlugin ep, typename Encoder> void register_encoder() {
             for (const auto &setting : Encoder::settings) {
               setting->obs_property(properties);
             }
+            for (const auto &option : Options::settings) {
+              option->obs_property(properties);
+            }
+            // Known once an encoder was created or the warm-up finished.
+            obs_video_info info;
+            if (obs_get_video_info(&info)) {
+              if (const auto caps = known_encoder_caps(
+                      info.adapter, Encoder::caps_properties)) {
+                restrict_properties(properties,
+                                    Encoder::setting_limits(*caps));
+              }
+            }
             return &properties;
           },
+      .update =
+          [](auto data, auto settings) noexcept {
+            return static_cast<Encoder *>(data)->update(*settings);
+          },
       .get_extra_data =
           [](auto data, auto extra_data, auto size) noexcept {
             const auto span = static_cast<Encoder *>(data)->get_extra_data();
             *extra_data = span.data();
             *size = span.size();
-            return true;
+            // Empty until the first keyframe when the encoder does not
+            // provide it up front.
+            return !span.empty();
           },
-      .caps = ep.use_texture ? OBS_ENCODER_CAP_PASS_TEXTURE : 0,
+      .caps = OBS_ENCODER_CAP_DYN_BITRATE |
+              (ep.use_texture ? OBS_ENCODER_CAP_PASS_TEXTURE : 0),
       .encode_texture =
           [](auto *data, auto handle, auto pts, auto lock_key, auto *next_key,
              auto *packet, auto *received_packet) noexcept {
@@ -86,6 +112,9 @@ template <EncoderPlugin ep, typename Encoder> void register_encoder() {
 OBS_DECLARE_MODULE()
 
 MODULE_EXPORT bool obs_module_load() {
+  init_log_level();
+  start_log_sink();
+
   // Correct codec is important because the name is passed to ffmpeg which needs
   // to recognize it.
 
@@ -117,7 +146,11 @@ MODULE_EXPORT bool obs_module_load() {
                        .use_texture = true,
                    },
                    EncoderHevc>();
+  start_warm_up();
   return true;
 }
 
-MODULE_EXPORT void obs_module_unload() {}
+MODULE_EXPORT void obs_module_unload() {
+  finish_warm_up();
+  stop_log_sink();
+}
@@ -3,11 +3,15 @@
 #include "gsl.h"
 #include "util.h"
 
+#include <algorithm>
+#include <string_view>
+
 BoolSetting::BoolSetting(not_null<czstring> name,
                          not_null<czstring> description,
-                         not_null<cwzstring> amf_name, bool default_) noexcept
-    : name{name}, description{description}, amf_name{amf_name}, default_{
-                                                                    default_} {}
+                         not_null<cwzstring> amf_name, bool default_,
+                         bool live_) noexcept
+    : name{name}, description{description}, amf_name{amf_name},
+      default_{default_}, live_{live_} {}
 
 void BoolSetting::obs_property(obs_properties &properties) const noexcept {
   ASSERT_(obs_properties_add_bool(&properties, name, description));
@@ -23,11 +27,15 @@ void BoolSetting::amf_property(obs_data &data,
   set_property_fallible(encoder, amf_name, value);
 }
 
+bool BoolSetting::changed(obs_data &a, obs_data &b) const noexcept {
+  return obs_data_get_bool(&a, name) != obs_data_get_bool(&b, name);
+}
+
 IntSetting::IntSetting(not_null<czstring> name, not_null<czstring> description,
                        not_null<cwzstring> amf_name, int min, int max,
-                       int default_) noexcept
+                       int default_, bool live_) noexcept
     : name{name}, description{description}, amf_name{amf_name}, min{min},
-      max{max}, default_{default_} {
+      max{max}, default_{default_}, live_{live_} {
   ASSERT_(this->default_ >= this->min && this->default_ <= this->max);
   ASSERT_(this->min <= this->max);
 }
@@ -52,13 +60,17 @@ void IntSetting::amf_property(obs_data &data,
   set_property_fallible(encoder, amf_name, static_cast<int64_t>(value));
 }
 
+bool IntSetting::changed(obs_data &a, obs_data &b) const noexcept {
+  return obs_data_get_int(&a, name) != obs_data_get_int(&b, name);
+}
+
 EnumSetting::EnumSetting(
     not_null<czstring> name, not_null<czstring> description,
     not_null<cwzstring> amf_name,
     std::vector<std::tuple<int, not_null<czstring>>> &&values,
-    size_t default_) noexcept
+    size_t default_, bool live_) noexcept
     : name{name}, description{description}, amf_name{amf_name}, values{values},
-      default_{default_} {
+      default_{default_}, live_{live_} {
   ASSERT_(this->default_ < this->values.size());
 }
 
@@ -81,3 +93,120 @@ void EnumSetting::amf_property(obs_data &data,
   const auto value{gsl::narrow<int>(obs_data_get_int(&data, name))};
   set_property_fallible(encoder, amf_name, static_cast<int64_t>(value));
 }
+
+bool EnumSetting::changed(obs_data &a, obs_data &b) const noexcept {
+  return obs_data_get_int(&a, name) != obs_data_get_int(&b, name);
+}
+
+BoolOption::BoolOption(not_null<czstring> name, not_null<czstring> description,
+                       bool default_) noexcept
+    : name{name}, description{description}, default_{default_} {}
+
+void BoolOption::obs_property(obs_properties &properties) const noexcept {
+  ASSERT_(obs_properties_add_bool(&properties, name, description));
+}
+
+void BoolOption::obs_default(obs_data &data) const noexcept {
+  obs_data_set_default_bool(&data, name, default_);
+}
+
+bool BoolOption::get(obs_data &data) const noexcept {
+  return obs_data_get_bool(&data, name);
+}
+
+bool BoolOption::changed(obs_data &a, obs_data &b) const noexcept {
+  return get(a) != get(b);
+}
+
+IntOption::IntOption(not_null<czstring> name, not_null<czstring> description,
+                     int min, int max, int default_) noexcept
+    : name{name}, description{description}, min{min}, max{max}, default_{
+                                                                    default_} {
+  ASSERT_(this->default_ >= this->min && this->default_ <= this->max);
+  ASSERT_(this->min <= this->max);
+}
+
+void IntOption::obs_property(obs_properties &properties) const noexcept {
+  if (max - min <= 10000) {
+    ASSERT_(obs_properties_add_int_slider(&properties, name, description, min,
+                                          max, 1));
+  } else {
+    ASSERT_(
+        obs_properties_add_int(&properties, name, description, min, max, 1));
+  }
+}
+
+void IntOption::obs_default(obs_data &data) const noexcept {
+  obs_data_set_default_int(&data, name, default_);
+}
+
+int IntOption::get(obs_data &data) const noexcept {
+  const auto value{obs_data_get_int(&data, name)};
+  return static_cast<int>(std::clamp<long long>(value, min, max));
+}
+
+bool IntOption::changed(obs_data &a, obs_data &b) const noexcept {
+  return get(a) != get(b);
+}
+
+EnumOption::EnumOption(
+    not_null<czstring> name, not_null<czstring> description,
+    std::vector<std::tuple<int, not_null<czstring>>> &&values,
+    size_t default_) noexcept
+    : name{name}, description{description}, values{values}, default_{
+                                                                default_} {
+  ASSERT_(this->default_ < this->values.size());
+}
+
+void EnumOption::obs_property(obs_properties &properties) const noexcept {
+  const auto p =
+      obs_properties_add_list(&properties, name, description,
+                              OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+  ASSERT_(p);
+  for (const auto &[value, name] : values) {
+    obs_property_list_add_int(p, name, value);
+  }
+}
+
+void EnumOption::obs_default(obs_data &data) const noexcept {
+  obs_data_set_default_int(&data, name, std::get<0>(values[default_]));
+}
+
+int EnumOption::get(obs_data &data) const noexcept {
+  const auto value{obs_data_get_int(&data, name)};
+  for (const auto &[known, _] : values) {
+    if (known == value) {
+      return known;
+    }
+  }
+  return std::get<0>(values[default_]);
+}
+
+bool EnumOption::changed(obs_data &a, obs_data &b) const noexcept {
+  return get(a) != get(b);
+}
+
+PathOption::PathOption(not_null<czstring> name, not_null<czstring> description,
+                       not_null<czstring> filter) noexcept
+    : name{name}, description{description}, filter{filter} {}
+
+void PathOption::obs_property(obs_properties &properties) const noexcept {
+  ASSERT_(obs_properties_add_path(&properties, name, description,
+                                  OBS_PATH_FILE_SAVE, filter, nullptr));
+}
+
+void PathOption::obs_default(obs_data &data) const noexcept {
+  obs_data_set_default_string(&data, name, "");
+}
+
+std::string PathOption::get(obs_data &data) const {
+  const auto *const value{obs_data_get_string(&data, name)};
+  return value ? value : "";
+}
+
+bool PathOption::changed(obs_data &a, obs_data &b) const noexcept {
+  const auto *const value_a{obs_data_get_string(&a, name)};
+  const auto *const value_b{obs_data_get_string(&b, name)};
+  return std::string_view{value_a ? value_a : ""} !=
+         std::string_view{value_b ? value_b : ""};
+}
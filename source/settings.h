@@ -10,6 +10,7 @@
 #include <AMF/components/Component.h>
 #include <obs-module.h>
 
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -22,6 +23,11 @@ struct Setting {
   virtual void obs_default(obs_data &) const noexcept = 0;
   // Set the setting on an AMF componenet (the encoder).
   virtual void amf_property(obs_data &, amf::AMFComponent &) const = 0;
+  virtual czstring obs_name() const noexcept = 0;
+  // Whether the value differs between the two data.
+  virtual bool changed(obs_data &, obs_data &) const noexcept = 0;
+  // Whether the encoder accepts changes after it has been initialized.
+  virtual bool live() const noexcept = 0;
 };
 
 class BoolSetting : public Setting {
@@ -29,13 +35,18 @@ class BoolSetting : public Setting {
   not_null<czstring> description;
   not_null<cwzstring> amf_name;
   bool default_;
+  bool live_;
 
 public:
   BoolSetting(not_null<czstring> name, not_null<czstring> description,
-              not_null<cwzstring> amf_name, bool default_) noexcept;
+              not_null<cwzstring> amf_name, bool default_,
+              bool live_ = false) noexcept;
   void obs_property(obs_properties &properties) const noexcept override;
   void obs_default(obs_data &data) const noexcept override;
   void amf_property(obs_data &data, amf::AMFComponent &encoder) const override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  bool live() const noexcept override { return live_; }
 };
 
 class IntSetting : public Setting {
@@ -45,14 +56,18 @@ class IntSetting : public Setting {
   int min;
   int max;
   int default_;
+  bool live_;
 
 public:
   IntSetting(not_null<czstring> name, not_null<czstring> description,
-             not_null<cwzstring> amf_name, int min, int max,
-             int default_) noexcept;
+             not_null<cwzstring> amf_name, int min, int max, int default_,
+             bool live_ = false) noexcept;
   void obs_property(obs_properties &properties) const noexcept override;
   void obs_default(obs_data &data) const noexcept override;
   void amf_property(obs_data &data, amf::AMFComponent &encoder) const override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  bool live() const noexcept override { return live_; }
 };
 
 class EnumSetting : public Setting {
@@ -63,13 +78,97 @@ class EnumSetting : public Setting {
   std::vector<std::tuple<int, not_null<czstring>>> values;
   // index into values
   size_t default_;
+  bool live_;
 
 public:
   EnumSetting(not_null<czstring> name, not_null<czstring> description,
               not_null<cwzstring> amf_name,
               std::vector<std::tuple<int, not_null<czstring>>> &&values,
-              size_t default_) noexcept;
+              size_t default_, bool live_ = false) noexcept;
   void obs_property(obs_properties &properties) const noexcept override;
   void obs_default(obs_data &data) const noexcept override;
   void amf_property(obs_data &data, amf::AMFComponent &encoder) const override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  bool live() const noexcept override { return live_; }
+};
+
+// A configuration value for the plugin itself rather than for AMF. Read by the
+// encoder when it is created.
+struct Option {
+  virtual ~Option() noexcept = default;
+  virtual void obs_property(obs_properties &) const noexcept = 0;
+  virtual void obs_default(obs_data &) const noexcept = 0;
+  virtual czstring obs_name() const noexcept = 0;
+  // Whether the value differs between the two data.
+  virtual bool changed(obs_data &, obs_data &) const noexcept = 0;
+};
+
+class BoolOption : public Option {
+  not_null<czstring> name;
+  not_null<czstring> description;
+  bool default_;
+
+public:
+  BoolOption(not_null<czstring> name, not_null<czstring> description,
+             bool default_) noexcept;
+  void obs_property(obs_properties &properties) const noexcept override;
+  void obs_default(obs_data &data) const noexcept override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  bool get(obs_data &data) const noexcept;
+};
+
+class IntOption : public Option {
+  not_null<czstring> name;
+  not_null<czstring> description;
+  int min;
+  int max;
+  int default_;
+
+public:
+  IntOption(not_null<czstring> name, not_null<czstring> description, int min,
+            int max, int default_) noexcept;
+  void obs_property(obs_properties &properties) const noexcept override;
+  void obs_default(obs_data &data) const noexcept override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  // Clamped to [min, max].
+  int get(obs_data &data) const noexcept;
+};
+
+class EnumOption : public Option {
+  not_null<czstring> name;
+  not_null<czstring> description;
+  // value, name
+  std::vector<std::tuple<int, not_null<czstring>>> values;
+  // index into values
+  size_t default_;
+
+public:
+  EnumOption(not_null<czstring> name, not_null<czstring> description,
+             std::vector<std::tuple<int, not_null<czstring>>> &&values,
+             size_t default_) noexcept;
+  void obs_property(obs_properties &properties) const noexcept override;
+  void obs_default(obs_data &data) const noexcept override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  // Falls back to the default for values that are not in the list.
+  int get(obs_data &data) const noexcept;
+};
+
+// Path to a file that the plugin writes to. Empty when unset.
+class PathOption : public Option {
+  not_null<czstring> name;
+  not_null<czstring> description;
+  not_null<czstring> filter;
+
+public:
+  PathOption(not_null<czstring> name, not_null<czstring> description,
+             not_null<czstring> filter) noexcept;
+  void obs_property(obs_properties &properties) const noexcept override;
+  void obs_default(obs_data &data) const noexcept override;
+  czstring obs_name() const noexcept override { return name; }
+  bool changed(obs_data &a, obs_data &b) const noexcept override;
+  std::string get(obs_data &data) const;
 };
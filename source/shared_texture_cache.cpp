@@ -0,0 +1,59 @@
+#include "shared_texture_cache.h"
+
+#include "util.h"
+
+#include <combaseapi.h>
+
+#include <stdexcept>
+
+SharedTextureCache::SharedTextureCache(CComPtr<ID3D11Device> device_,
+                                       size_t capacity_)
+    : device{device_}, capacity{capacity_} {
+  ASSERT_(capacity > 0);
+  index.reserve(capacity);
+}
+
+ObsTexture SharedTextureCache::open(uint32_t handle) {
+  ++stats_.opens;
+  CComPtr<ID3D11Texture2D> texture;
+  if (device->OpenSharedResource(
+          reinterpret_cast<HANDLE>(static_cast<uintptr_t>(handle)),
+          IID_PPV_ARGS(&texture)) < 0) {
+    throw std::runtime_error("OpenSharedResource");
+  }
+  CComPtr<IDXGIKeyedMutex> mutex;
+  if (texture->QueryInterface(IID_PPV_ARGS(&mutex)) < 0) {
+    throw std::runtime_error("QueryInterface");
+  }
+  texture->SetEvictionPriority(DXGI_RESOURCE_PRIORITY_MAXIMUM);
+  return {handle, texture, mutex, generation};
+}
+
+ObsTexture &SharedTextureCache::get(uint32_t handle) {
+  if (const auto cached{index.find(handle)}; cached != index.end()) {
+    const auto entry{cached->second};
+    if (entry->generation == generation) {
+      ++stats_.hits;
+    } else {
+      *entry = open(handle);
+    }
+    entries.splice(entries.begin(), entries, entry);
+    return *entry;
+  }
+
+  auto texture{open(handle)};
+  if (entries.size() == capacity) {
+    index.erase(entries.back().handle);
+    entries.pop_back();
+    ++stats_.evictions;
+  }
+  entries.push_front(std::move(texture));
+  index.emplace(handle, entries.begin());
+  return entries.front();
+}
+
+void SharedTextureCache::invalidate() noexcept { ++generation; }
+
+SharedTextureCacheStats SharedTextureCache::stats() const noexcept {
+  return stats_;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atlbase.h>
+#include <d3d11.h>
+#include <dxgi.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// OBS reuses a limited number of handles (which is not documented). There is
+// some work we need to do in obs_texture_from_handle once per handle which we
+// cache here.
+struct ObsTexture {
+  uint32_t handle;
+  CComPtr<ID3D11Texture2D> texture;
+  CComPtr<IDXGIKeyedMutex> mutex;
+  // Cache generation the texture was opened in.
+  uint64_t generation;
+};
+
+struct SharedTextureCacheStats {
+  uint64_t hits;
+  // Handles that had to be opened because they were not cached or stale.
+  uint64_t opens;
+  uint64_t evictions;
+};
+
+// Maps OBS shared texture handles to opened textures. Bounded so that
+// textures from handles OBS no longer uses are released.
+class SharedTextureCache {
+  CComPtr<ID3D11Device> device;
+  size_t capacity;
+  // Most recently used first.
+  std::list<ObsTexture> entries;
+  std::unordered_map<uint32_t, std::list<ObsTexture>::iterator> index;
+  // Entries from older generations are reopened on their next lookup.
+  uint64_t generation{0};
+  SharedTextureCacheStats stats_{};
+
+  ObsTexture open(uint32_t handle);
+
+public:
+  SharedTextureCache(CComPtr<ID3D11Device>, size_t capacity);
+
+  // Retrieve the texture from the cache or open and insert it.
+  ObsTexture &get(uint32_t handle);
+  // Reopen every texture on its next lookup. Used when the textures might
+  // have become invalid like after a graphics reset.
+  void invalidate() noexcept;
+  SharedTextureCacheStats stats() const noexcept;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+// Bounded lock free queue for exactly one producer thread and one consumer
+// thread. Neither side ever blocks; push fails when full and pop fails when
+// empty.
+template <typename T> class SpscQueue {
+  // Keep the producer and consumer indices on separate cache lines so that
+  // the two threads do not invalidate each other's line on every operation.
+  static constexpr size_t cache_line{64};
+
+  // One slot more than the capacity so that full and empty can be told apart.
+  const size_t slot_count;
+  std::unique_ptr<std::optional<T>[]> slots;
+  // Next slot to write. Only modified by the producer.
+  alignas(cache_line) std::atomic<size_t> head{0};
+  // Next slot to read. Only modified by the consumer.
+  alignas(cache_line) std::atomic<size_t> tail{0};
+
+  size_t next(size_t index) const noexcept {
+    return index + 1 == slot_count ? 0 : index + 1;
+  }
+
+public:
+  explicit SpscQueue(size_t capacity)
+      : slot_count{capacity + 1}, slots{new std::optional<T>[capacity + 1]} {}
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  // Producer only. Returns false and leaves value untouched when full.
+  bool push(T &&value) {
+    const auto current{head.load(std::memory_order_relaxed)};
+    const auto following{next(current)};
+    if (following == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots[current].emplace(std::move(value));
+    head.store(following, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only.
+  std::optional<T> pop() {
+    const auto current{tail.load(std::memory_order_relaxed)};
+    if (current == head.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+    std::optional<T> value{std::move(slots[current])};
+    slots[current].reset();
+    tail.store(next(current), std::memory_order_release);
+    return value;
+  }
+
+  // Approximate when called concurrently with push or pop.
+  size_t size() const noexcept {
+    const auto h{head.load(std::memory_order_acquire)};
+    const auto t{tail.load(std::memory_order_acquire)};
+    return h >= t ? h - t : h + slot_count - t;
+  }
+
+  size_t capacity() const noexcept { return slot_count - 1; }
+};
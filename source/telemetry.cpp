@@ -0,0 +1,102 @@
+#include "telemetry.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace {
+
+constexpr auto not_measured{std::numeric_limits<double>::quiet_NaN()};
+
+// Mean of the values added so far or NaN when there are none.
+struct Mean {
+  double sum{0};
+  size_t count{0};
+
+  void add(double value) noexcept {
+    sum += value;
+    ++count;
+  }
+
+  double get() const noexcept { return count > 0 ? sum / count : not_measured; }
+};
+
+} // namespace
+
+TelemetryRing::TelemetryRing(size_t capacity) : records(capacity) {}
+
+FrameTelemetry &TelemetryRing::push() noexcept {
+  return records[pushed++ % records.size()];
+}
+
+uint64_t TelemetryRing::total() const noexcept { return pushed; }
+
+size_t TelemetryRing::capacity() const noexcept { return records.size(); }
+
+const FrameTelemetry &TelemetryRing::at(uint64_t index) const noexcept {
+  return records[index % records.size()];
+}
+
+TelemetrySummary TelemetryRing::summarize() const noexcept {
+  const auto frames{
+      static_cast<size_t>(std::min<uint64_t>(pushed, records.size()))};
+  Mean qp;
+  Mean psnr;
+  Mean ssim;
+  auto min_psnr{not_measured};
+  int64_t intra{0};
+  int64_t skip{0};
+  int64_t pixels{0};
+  for (size_t i{0}; i < frames; ++i) {
+    const auto &record{records[i]};
+    if (record.average_qp >= 0) {
+      qp.add(static_cast<double>(record.average_qp));
+    }
+    if (record.intra_pixels >= 0 && record.inter_pixels >= 0 &&
+        record.skip_pixels >= 0) {
+      intra += record.intra_pixels;
+      skip += record.skip_pixels;
+      pixels +=
+          record.intra_pixels + record.inter_pixels + record.skip_pixels;
+    }
+    if (!std::isnan(record.psnr)) {
+      psnr.add(record.psnr);
+      min_psnr = std::isnan(min_psnr) ? record.psnr
+                                      : std::min(min_psnr, record.psnr);
+    }
+    if (!std::isnan(record.ssim)) {
+      ssim.add(record.ssim);
+    }
+  }
+  const auto fraction{[pixels](int64_t part) {
+    return pixels > 0 ? static_cast<double>(part) / pixels : not_measured;
+  }};
+  return {
+      .frames = frames,
+      .average_qp = qp.get(),
+      .intra_fraction = fraction(intra),
+      .skip_fraction = fraction(skip),
+      .psnr = psnr.get(),
+      .min_psnr = min_psnr,
+      .ssim = ssim.get(),
+  };
+}
+
+std::string telemetry_csv_header() {
+  return "pts,bytes,keyframe,frame_qp,average_qp,min_qp,max_qp,intra_pixels,"
+         "inter_pixels,skip_pixels,residual_bits,motion_bits,"
+         "bits_without_header,psnr,ssim\n";
+}
+
+void append_telemetry_csv(std::string &out, const FrameTelemetry &record) {
+  fmt::format_to(std::back_inserter(out),
+                 "{},{},{:d},{},{},{},{},{},{},{},{},{},{},{:.4f},{:.6f}\n",
+                 record.pts, record.bytes, record.keyframe, record.frame_qp,
+                 record.average_qp, record.min_qp, record.max_qp,
+                 record.intra_pixels, record.inter_pixels, record.skip_pixels,
+                 record.residual_bits, record.motion_bits,
+                 record.bits_without_header, record.psnr, record.ssim);
+}
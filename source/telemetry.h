@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the encoder reported about one frame when feedback was requested.
+// Plain fields so that records can be written without allocating.
+struct FrameTelemetry {
+  int64_t pts;
+  uint64_t bytes;
+  bool keyframe;
+  // -1 when not reported.
+  int64_t frame_qp;
+  int64_t average_qp;
+  int64_t min_qp;
+  int64_t max_qp;
+  int64_t intra_pixels;
+  int64_t inter_pixels;
+  int64_t skip_pixels;
+  int64_t residual_bits;
+  int64_t motion_bits;
+  int64_t bits_without_header;
+  // NaN when not measured.
+  double psnr;
+  double ssim;
+};
+
+// Averages over the frames in a TelemetryRing. Fields are NaN when no frame
+// reported them.
+struct TelemetrySummary {
+  size_t frames;
+  double average_qp;
+  double intra_fraction;
+  double skip_fraction;
+  double psnr;
+  double min_psnr;
+  double ssim;
+};
+
+// The most recent frames. Storage is allocated once and the oldest record is
+// overwritten when full.
+class TelemetryRing {
+  std::vector<FrameTelemetry> records;
+  // Records ever pushed.
+  uint64_t pushed{0};
+
+public:
+  explicit TelemetryRing(size_t capacity);
+
+  // The record to fill in for the next frame.
+  FrameTelemetry &push() noexcept;
+
+  uint64_t total() const noexcept;
+  size_t capacity() const noexcept;
+  // Record number index counted from the first push. Must be one of the last
+  // capacity records.
+  const FrameTelemetry &at(uint64_t index) const noexcept;
+
+  // Rolling summary of the frames still held.
+  TelemetrySummary summarize() const noexcept;
+};
+
+std::string telemetry_csv_header();
+// Appends one line including the line break.
+void append_telemetry_csv(std::string &, const FrameTelemetry &);
@@ -1,5 +1,6 @@
 #include "texture_encoder.h"
 
+#include "device_registry.h"
 #include "util.h"
 
 #include <fmt/core.h>
@@ -7,7 +8,6 @@
 
 #include <combaseapi.h>
 
-#include <algorithm>
 #include <stdexcept>
 
 namespace {
@@ -30,52 +30,23 @@ TextureEncoder::TextureEncoder(amf::AMFContextPtr amf_context_,
                                CComPtr<ID3D11Device> device_,
                                CComPtr<ID3D11DeviceContext> context_,
                                uint32_t width, uint32_t height,
-                               amf::AMF_SURFACE_FORMAT format)
+                               amf::AMF_SURFACE_FORMAT format,
+                               size_t shared_texture_cache_size,
+                               size_t ring_size,
+                               std::chrono::milliseconds ring_wait_,
+                               std::chrono::milliseconds acquire_timeout_,
+                               bool repeat_on_timeout_)
     : amf_context{amf_context_}, device{device_}, context{context_},
       texture_width{width}, texture_height{height},
-      texture_format{amf_surface_format_to_dx11(format)} {}
-
-TextureEncoder::~TextureEncoder() noexcept {
-  // Unregister all observers because we are getting destroyed.
-  for (auto &texture : amf_textures) {
-    if (texture.surface) {
-      texture.surface->RemoveObserver(this);
-    }
-  }
-}
-
-ObsTexture &TextureEncoder::obs_texture_from_handle(uint32_t handle) {
-  const auto cached{std::find_if(
-      obs_textures.begin(), obs_textures.end(),
-      [=](const auto &cached) { return cached.handle == handle; })};
-  if (cached != obs_textures.end()) {
-    return *cached;
-  }
-
-  CComPtr<ID3D11Texture2D> texture;
-  if (device->OpenSharedResource(
-          reinterpret_cast<HANDLE>(static_cast<uintptr_t>(handle)),
-          IID_PPV_ARGS(&texture)) < 0) {
-    throw std::runtime_error("OpenSharedResource");
-  }
-  CComPtr<IDXGIKeyedMutex> mutex;
-  if (texture->QueryInterface(IID_PPV_ARGS(&mutex)) < 0) {
-    throw std::runtime_error("QueryInterface");
-  }
-  texture->SetEvictionPriority(DXGI_RESOURCE_PRIORITY_MAXIMUM);
-  obs_textures.push_back({handle, texture, mutex});
-  return obs_textures.back();
-}
-
-AmfTexture &TextureEncoder::unused_amf_texture() {
-  const auto cached{
-      std::find_if(amf_textures.begin(), amf_textures.end(),
-                   [=](const auto &texture) { return !texture.in_use(); })};
-  if (cached != amf_textures.end()) {
-    return *cached;
-  }
-
-  D3D11_TEXTURE2D_DESC desc = {
+      texture_format{amf_surface_format_to_dx11(format)},
+      obs_textures{device_, shared_texture_cache_size},
+      acquire_timeout{acquire_timeout_}, repeat_on_timeout{repeat_on_timeout_},
+      amf_textures{new CComPtr<ID3D11Texture2D>[ring_size]},
+      amf_texture_slots{ring_size, ring_wait_} {
+  ASSERT_(ring_size > 0);
+  // Creating textures while encoding causes frame time spikes so we create
+  // all of them now.
+  const D3D11_TEXTURE2D_DESC desc = {
       .Width = texture_width,
       .Height = texture_height,
       .MipLevels = 1,
@@ -84,25 +55,50 @@ AmfTexture &TextureEncoder::unused_amf_texture() {
       .SampleDesc = {.Count = 1},
       .BindFlags = D3D11_BIND_RENDER_TARGET,
   };
-  CComPtr<ID3D11Texture2D> texture;
-  if (device->CreateTexture2D(&desc, NULL, &texture) < 0) {
-    throw std::runtime_error("CreateTexture2d");
+  for (size_t i{0}; i < ring_size; ++i) {
+    if (device->CreateTexture2D(&desc, NULL, &amf_textures[i]) < 0) {
+      throw std::runtime_error("CreateTexture2d");
+    }
+  }
+}
+
+amf::AMFSurfacePtr TextureEncoder::amf_texture_to_surface(size_t index) {
+  amf::AMFSurfacePtr surface;
+  if (amf_context->CreateSurfaceFromDX11Native(
+          amf_textures[index], &surface, amf_texture_slots.observer()) !=
+      AMF_OK) {
+    amf_texture_slots.release(index);
+    throw std::runtime_error("CreateSurfaceFromDX11Native");
   }
-  amf_textures.push_back({.texture = texture, .surface = nullptr});
-  return amf_textures.back();
+  amf_texture_slots.attach(index, *surface);
+  return surface;
 }
 
-void TextureEncoder::OnSurfaceDataRelease(amf::AMFSurface *surface) {
-  const auto texture{std::find_if(
-      amf_textures.begin(), amf_textures.end(),
-      [=](const auto &texture) { return texture.surface == surface; })};
-  ASSERT_(texture != amf_textures.end());
-  texture->surface = nullptr;
+amf::AMFSurfacePtr
+TextureEncoder::acquire_timed_out(std::optional<size_t> index) {
+  ++mutex_stats.timeouts;
+  log(LOG_WARNING, "timed out waiting for OBS to release the frame texture");
+  if (!index) {
+    return nullptr;
+  }
+  if (!repeat_on_timeout || !last_texture) {
+    amf_texture_slots.release(*index);
+    return nullptr;
+  }
+  // The ring can hand out the last texture again because it was released in
+  // the meantime. Then it already holds the frame.
+  if (*index != *last_texture) {
+    const Dx11Lock lock{*amf_context};
+    context->CopyResource(amf_textures[*index], amf_textures[*last_texture]);
+  }
+  last_texture = *index;
+  ++mutex_stats.repeats;
+  return amf_texture_to_surface(*index);
 }
 
-not_null<amf::AMFSurfacePtr>
-TextureEncoder::texture_to_surface(uint32_t handle, uint64_t lock_key,
-                                   uint64_t &next_key) {
+amf::AMFSurfacePtr TextureEncoder::texture_to_surface(uint32_t handle,
+                                                      uint64_t lock_key,
+                                                      uint64_t &next_key) {
   // There are things copied from jim-nvenc whose purpose is unclear:
   // - Why wouldn't OBS check for GS_INVALID_HANDLE itself before calling the
   // encoder?
@@ -113,20 +109,56 @@ TextureEncoder::texture_to_surface(uint32_t handle, uint64_t lock_key,
   if (handle == GS_INVALID_HANDLE) {
     throw std::runtime_error("GS_INVALID_HANDLE");
   }
-  auto &obs_texture = obs_texture_from_handle(handle);
-  auto &amf_texture = unused_amf_texture();
-  obs_texture.mutex->AcquireSync(lock_key, INFINITE);
-  context->CopyResource(amf_texture.texture, obs_texture.texture);
-  obs_texture.mutex->ReleaseSync(next_key);
-  amf::AMFSurfacePtr surface;
-  if (amf_context->CreateSurfaceFromDX11Native(amf_texture.texture, &surface,
-                                               this) != AMF_OK) {
-    throw std::runtime_error("CreateSurfaceFromDX11Native");
+  auto &obs_texture = obs_textures.get(handle);
+  const auto index{amf_texture_slots.acquire()};
+  const auto wait_start{std::chrono::steady_clock::now()};
+  const auto result{obs_texture.mutex->AcquireSync(
+      lock_key, acquire_timeout.count() > 0
+                    ? static_cast<DWORD>(acquire_timeout.count())
+                    : INFINITE)};
+  mutex_stats.wait.record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - wait_start));
+  if (result == WAIT_TIMEOUT) {
+    // We do not own the mutex so we cannot release it to next_key. Telling OBS
+    // to acquire it with the key it was released with keeps it going.
+    next_key = lock_key;
+    return acquire_timed_out(index);
   }
-  amf_texture.surface = surface;
-#if 0
-  log(LOG_DEBUG, "obs_textures {}, amf_textures {}", obs_textures.size(),
-      amf_textures.size());
-#endif
-  return surface;
+  if (result != S_OK) {
+    if (index) {
+      amf_texture_slots.release(*index);
+    }
+    // The texture was abandoned or the device was lost. Make sure we do not
+    // keep using textures opened before.
+    obs_textures.invalidate();
+    throw std::runtime_error("AcquireSync");
+  }
+  if (!index) {
+    // Still hand the texture back to OBS or it freezes.
+    obs_texture.mutex->ReleaseSync(next_key);
+    return nullptr;
+  }
+  {
+    // The immediate context is shared with other encoders on the device.
+    const Dx11Lock lock{*amf_context};
+    context->CopyResource(amf_textures[*index], obs_texture.texture);
+  }
+  obs_texture.mutex->ReleaseSync(next_key);
+  last_texture = *index;
+  return amf_texture_to_surface(*index);
+}
+
+SharedTextureCacheStats
+TextureEncoder::shared_texture_cache_stats() const noexcept {
+  return obs_textures.stats();
+}
+
+TextureRingStats TextureEncoder::texture_ring_stats() const noexcept {
+  return amf_texture_slots.stats();
+}
+
+KeyedMutexStats TextureEncoder::take_keyed_mutex_stats() noexcept {
+  auto stats{mutex_stats};
+  mutex_stats.wait.clear();
+  return stats;
 }
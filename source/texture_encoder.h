@@ -1,4 +1,9 @@
+#pragma once
+
 #include "gsl.h"
+#include "latency_histogram.h"
+#include "shared_texture_cache.h"
+#include "texture_slots.h"
 
 #include <AMF/core/Context.h>
 #include <AMF/core/Surface.h>
@@ -7,63 +12,78 @@
 #include <d3d11.h>
 #include <dxgi.h>
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <memory>
+#include <optional>
 
-// OBS reuses a limited number of handles (which is not documented). There is
-// some work we need to do in obs_textre_from_handle once per handle which we
-// cache here.
-struct ObsTexture {
-  uint32_t handle;
-  CComPtr<ID3D11Texture2D> texture;
-  CComPtr<IDXGIKeyedMutex> mutex;
+struct KeyedMutexStats {
+  // AcquireSync ran into the timeout.
+  uint64_t timeouts;
+  // Frames encoded as a repeat of the previous frame after a timeout.
+  uint64_t repeats;
+  // Time spent in AcquireSync since the last report.
+  LatencyHistogram wait;
 };
 
-// We pass textures to AMF to create a surface from. These textures need to stay
-// alive until AMF notifies us that the surface is no longer needed. After which
-// we can reuse them.
-struct AmfTexture {
-  CComPtr<ID3D11Texture2D> texture;
-  // Set when we create a surface from the texture. Unset when we are notified
-  // that the surface is no longer used by AMF through OnSurfaceDataRelease.
-  // Stores an observer to this TextureEncoder.
-  amf::AMFSurface *surface;
-
-  inline bool in_use() const noexcept { return surface; }
-};
-
-class TextureEncoder : private amf::AMFSurfaceObserver {
+class TextureEncoder {
   amf::AMFContextPtr amf_context;
   CComPtr<ID3D11Device> device;
   CComPtr<ID3D11DeviceContext> context;
   uint32_t texture_width;
   uint32_t texture_height;
   DXGI_FORMAT texture_format;
-  std::vector<ObsTexture> obs_textures;
-  // TODO: Use mutex? Not sure when observer callback can happen.
-  std::vector<AmfTexture> amf_textures;
+  SharedTextureCache obs_textures;
+  // 0 waits forever.
+  std::chrono::milliseconds acquire_timeout;
+  // On an acquire timeout encode the previous frame again instead of skipping.
+  bool repeat_on_timeout;
+
+  // We pass these textures to AMF to create surfaces from. They need to stay
+  // alive until AMF notifies us that the surface is no longer needed. After
+  // which we can reuse them. Allocated up front and never resized.
+  std::unique_ptr<CComPtr<ID3D11Texture2D>[]> amf_textures;
+  // Which of amf_textures AMF uses. Declared after them so that it stops
+  // observing the surfaces before the textures are released.
+  TextureSlots amf_texture_slots;
+  // Texture holding the most recent frame. Its content stays intact until
+  // the texture is acquired again which only the encode thread does.
+  std::optional<size_t> last_texture;
+  // Only accessed by the encode thread.
+  KeyedMutexStats mutex_stats{};
 
-  // Retrieve the texture from obs_textures or create and insert it.
-  ObsTexture &obs_texture_from_handle(uint32_t handle);
-  // Retrieve an unused texture from amf_textures or create and insert it.
-  AmfTexture &unused_amf_texture();
-  // From AMFSurfaceObserver. Marksthe texture in amf_textures as unused.
-  void OnSurfaceDataRelease(amf::AMFSurface *) override;
+  // Create a surface for an acquired texture.
+  amf::AMFSurfacePtr amf_texture_to_surface(size_t index);
+  // Handle an AcquireSync timeout. Returns nullptr when skipping.
+  amf::AMFSurfacePtr acquire_timed_out(std::optional<size_t> index);
 
 public:
-  // amf_context must have been initialized with the same device.
+  // amf_context must have been initialized with the same device. Creates
+  // ring_size textures up front.
   TextureEncoder(amf::AMFContextPtr, CComPtr<ID3D11Device>,
                  CComPtr<ID3D11DeviceContext>, uint32_t width, uint32_t height,
-                 amf::AMF_SURFACE_FORMAT);
-  ~TextureEncoder() noexcept;
+                 amf::AMF_SURFACE_FORMAT, size_t shared_texture_cache_size,
+                 size_t ring_size, std::chrono::milliseconds ring_wait,
+                 std::chrono::milliseconds acquire_timeout,
+                 bool repeat_on_timeout);
 
-  // Delete moving because it would invalidate the surface observer pointer to
-  // this. Delete copying because it would mess with the caches.
+  // Delete moving because it would invalidate the surface observer pointer in
+  // amf_texture_slots. Delete copying because it would mess with the caches.
   TextureEncoder(const TextureEncoder &) = delete;
   TextureEncoder(TextureEncoder &&) = delete;
   TextureEncoder &operator=(const TextureEncoder &) = delete;
   TextureEncoder &operator=(TextureEncoder &&) = delete;
 
-  not_null<amf::AMFSurfacePtr>
-  texture_to_surface(uint32_t handle, uint64_t lock_key, uint64_t &next_key);
+  // Returns nullptr if the frame was skipped because the ring was exhausted or
+  // OBS' texture could not be acquired in time. OBS can always continue: the
+  // texture is released to next_key or, if we never acquired it, next_key is
+  // set to lock_key.
+  amf::AMFSurfacePtr texture_to_surface(uint32_t handle, uint64_t lock_key,
+                                        uint64_t &next_key);
+  SharedTextureCacheStats shared_texture_cache_stats() const noexcept;
+  // Must be called from the encode thread.
+  TextureRingStats texture_ring_stats() const noexcept;
+  // Must be called from the encode thread. Resets the wait histogram.
+  KeyedMutexStats take_keyed_mutex_stats() noexcept;
 };
@@ -0,0 +1,91 @@
+#include "texture_slots.h"
+
+#include "gsl.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// Set on surfaces to the index of their slot.
+const not_null<cwzstring> slot_property{L"amf_texture_slot"};
+
+// How often acquire checks for a released slot while stalling.
+constexpr std::chrono::microseconds poll_interval{200};
+
+} // namespace
+
+TextureSlots::TextureSlots(size_t count, std::chrono::milliseconds wait_)
+    : surfaces{new std::atomic<amf::AMFSurface *>[count]}, slot_count{count},
+      free_slots{count}, wait{wait_} {
+  for (size_t i{0}; i < count; ++i) {
+    surfaces[i].store(nullptr, std::memory_order_relaxed);
+    free_slots.push(i);
+  }
+}
+
+TextureSlots::~TextureSlots() noexcept {
+  for (size_t i{0}; i < slot_count; ++i) {
+    if (const auto surface{surfaces[i].exchange(nullptr)}) {
+      surface->RemoveObserver(this);
+    }
+  }
+  // An observer call that took a slot before us is still pushing it to
+  // free_slots.
+  while (releasing.load() > 0) {
+    std::this_thread::yield();
+  }
+}
+
+std::optional<size_t> TextureSlots::acquire() {
+  size_t slot;
+  if (!free_slots.pop(slot)) {
+    // Rare so we poll instead of making the release path signal us.
+    ++ring_stats.stalls;
+    const auto deadline{std::chrono::steady_clock::now() + wait};
+    while (!free_slots.pop(slot)) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        ++ring_stats.skips;
+        return std::nullopt;
+      }
+      timer.sleep(poll_interval);
+    }
+  }
+  ++acquired;
+  const auto in_use{acquired - released.load(std::memory_order_relaxed)};
+  ring_stats.high_water_mark =
+      std::max(ring_stats.high_water_mark, static_cast<size_t>(in_use));
+  return slot;
+}
+
+void TextureSlots::release(size_t slot) noexcept {
+  released.fetch_add(1, std::memory_order_relaxed);
+  free_slots.push(slot);
+}
+
+void TextureSlots::attach(size_t slot, amf::AMFSurface &surface) {
+  // Lets OnSurfaceDataRelease find the slot without searching.
+  if (surface.SetProperty(slot_property, static_cast<int64_t>(slot)) !=
+      AMF_OK) {
+    // The observer would not find the slot when the surface is released.
+    surface.RemoveObserver(this);
+    release(slot);
+    throw std::runtime_error("SetProperty amf_texture_slot");
+  }
+  surfaces[slot].store(&surface, std::memory_order_release);
+}
+
+void TextureSlots::OnSurfaceDataRelease(amf::AMFSurface *surface) {
+  releasing.fetch_add(1);
+  int64_t slot{-1};
+  surface->GetProperty(slot_property, &slot);
+  Expects(slot >= 0 && static_cast<size_t>(slot) < slot_count);
+  // Loses against the destructor which then owns the slot.
+  if (surfaces[static_cast<size_t>(slot)].exchange(nullptr)) {
+    release(static_cast<size_t>(slot));
+  }
+  releasing.fetch_sub(1);
+}
+
+TextureRingStats TextureSlots::stats() const noexcept { return ring_stats; }
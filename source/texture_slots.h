@@ -0,0 +1,81 @@
+#pragma once
+
+#include "free_index_stack.h"
+#include "waitable_timer.h"
+
+#include <AMF/core/Surface.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+struct TextureRingStats {
+  // Frames that had to wait for a texture to be released.
+  uint64_t stalls;
+  // Frames that were skipped because no texture was released in time.
+  uint64_t skips;
+  // Largest number of textures in use at the same time.
+  size_t high_water_mark;
+};
+
+// Tracks which textures of the texture ring AMF is using. A slot is acquired
+// for a frame, the surface made from its texture is attached to it, and the
+// slot is free again once AMF notifies us that it no longer needs the surface.
+//
+// AMF may release surfaces from its own threads so the release path only
+// touches atomics and never blocks. Relies on RemoveObserver not returning
+// while AMF is calling the observer for that surface.
+class TextureSlots : private amf::AMFSurfaceObserver {
+  // The surface AMF holds for each slot. Stores an observer to this. Whoever
+  // exchanges it to nullptr first, the observer or the destructor, owns the
+  // release.
+  std::unique_ptr<std::atomic<amf::AMFSurface *>[]> surfaces;
+  size_t slot_count;
+  // Slots that AMF does not use. Pushed by OnSurfaceDataRelease on any thread,
+  // popped by the encode thread.
+  FreeIndexStack free_slots;
+  std::chrono::milliseconds wait;
+  // Paces polling for a free slot while all are in use.
+  WaitableTimer timer;
+  // Their difference is the number of slots in use.
+  uint64_t acquired{0};
+  std::atomic<uint64_t> released{0};
+  // Calls to OnSurfaceDataRelease in progress. The destructor waits for those
+  // that won a slot from it.
+  std::atomic<size_t> releasing{0};
+  // Only accessed by the encode thread.
+  TextureRingStats ring_stats{};
+
+  // From AMFSurfaceObserver. Frees the slot the surface is attached to.
+  void OnSurfaceDataRelease(amf::AMFSurface *) override;
+
+public:
+  // wait is how long acquire waits for a slot when all are in use.
+  TextureSlots(size_t count, std::chrono::milliseconds wait);
+  // Stops observing the surfaces AMF still holds.
+  ~TextureSlots() noexcept;
+
+  // Delete moving because it would invalidate the observer pointer to this.
+  TextureSlots(const TextureSlots &) = delete;
+  TextureSlots(TextureSlots &&) = delete;
+  TextureSlots &operator=(const TextureSlots &) = delete;
+  TextureSlots &operator=(TextureSlots &&) = delete;
+
+  size_t size() const noexcept { return slot_count; }
+  // Take an unused slot. Waits up to wait for one to be released. Returns
+  // nullopt if none was. Encode thread only.
+  std::optional<size_t> acquire();
+  // Give back an acquired slot that no surface was attached to.
+  void release(size_t slot) noexcept;
+  // Pass to AMF when creating the surface for a slot.
+  amf::AMFSurfaceObserver *observer() noexcept { return this; }
+  // Attach the surface created for an acquired slot. The slot is free again
+  // when AMF releases the surface. Throws and releases the slot if the surface
+  // cannot be tagged with its slot.
+  void attach(size_t slot, amf::AMFSurface &);
+  // Encode thread only.
+  TextureRingStats stats() const noexcept;
+};
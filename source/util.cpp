@@ -1,7 +1,11 @@
 #include "util.h"
 
 #include <codecvt>
+#include <cstdlib>
 #include <locale>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 // I am not confident in the correctness of this implementation.
 std::string wstring_to_string(not_null<cwzstring> wstring) {
@@ -9,3 +13,32 @@ std::string wstring_to_string(not_null<cwzstring> wstring) {
       convert;
   return convert.to_bytes(wstring);
 }
+
+const std::string &property_name(not_null<cwzstring> name) {
+  static std::mutex mutex;
+  // Keyed by address. References to elements stay valid when it grows.
+  static std::unordered_map<cwzstring, std::string> names;
+  std::scoped_lock lock{mutex};
+  auto found{names.find(name)};
+  if (found == names.end()) {
+    found = names.emplace(name, wstring_to_string(name)).first;
+  }
+  return found->second;
+}
+
+void init_log_level() noexcept {
+  const auto *const value{std::getenv("AMFTEST_LOG")};
+  if (!value) {
+    return;
+  }
+  const std::string_view level{value};
+  if (level == "error") {
+    max_log_level = LOG_ERROR;
+  } else if (level == "warning") {
+    max_log_level = LOG_WARNING;
+  } else if (level == "info") {
+    max_log_level = LOG_INFO;
+  } else if (level == "debug") {
+    max_log_level = LOG_DEBUG;
+  }
+}
@@ -8,19 +8,57 @@
 #include <AMF/core/PropertyStorage.h>
 #include <fmt/format.h>
 
+#include <atomic>
 #include <concepts>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <utility>
+
+// Most verbose level that is compiled in. Build with it set to LOG_INFO to
+// remove debug logging entirely.
+#ifndef AMFTEST_LOG_LEVEL
+#define AMFTEST_LOG_LEVEL LOG_DEBUG
+#endif
+
+// Most verbose level that is logged. OBS discards debug lines in most
+// configurations so they are off unless init_log_level turns them on.
+inline std::atomic<int> max_log_level{LOG_INFO};
+
+// Reads the AMFTEST_LOG environment variable (error, warning, info or debug).
+void init_log_level() noexcept;
+
+// Lower levels are more severe. Levels above the limits are skipped before
+// any arguments are formatted.
+inline bool log_enabled(int log_level) noexcept {
+  return log_level <= AMFTEST_LOG_LEVEL &&
+         log_level <= max_log_level.load(std::memory_order_relaxed);
+}
 
 // Better than dealing with printf style formatting even if less efficient
-// because of the intermediate string we allocate.
+// because of the intermediate buffer. Short messages do not allocate.
 template <typename... T>
 inline void log(int log_level, fmt::format_string<T...> fmt, T &&...args) {
-  blog(log_level, "amftest: %s", fmt::format(fmt, args...).c_str());
+  if (!log_enabled(log_level)) {
+    return;
+  }
+  fmt::memory_buffer buffer;
+  fmt::format_to(std::back_inserter(buffer), fmt, std::forward<T>(args)...);
+  blog(log_level, "amftest: %.*s", static_cast<int>(buffer.size()),
+       buffer.data());
 }
 
 std::string wstring_to_string(not_null<cwzstring> wstring);
 
+// The name of an AMF property for logging. Converted once per name because
+// names are string literals, which is also required of the argument.
+const std::string &property_name(not_null<cwzstring> name);
+
+// Owns one reference to OBS data.
+using ObsData = std::unique_ptr<obs_data, decltype(&obs_data_release)>;
+
 // Assert that always runs. On false logs location and terminates.
 #define ASSERT_(condition)                                                     \
   if (!(condition)) {                                                          \
@@ -38,7 +76,7 @@ void set_property(amf::AMFPropertyStorage &storage, not_null<cwzstring> name,
                   const T &value) {
   if (storage.SetProperty(name, value) != AMF_OK) {
     throw std::runtime_error(
-        fmt::format("SetProperty {} {}", wstring_to_string(name), value));
+        fmt::format("SetProperty {} {}", property_name(name), value));
   }
 }
 
@@ -47,11 +85,11 @@ template <AmfVariant T>
 void set_property_fallible(amf::AMFPropertyStorage &storage,
                            not_null<cwzstring> name, const T &value) noexcept {
   if (storage.SetProperty(name, value) == AMF_OK) {
-    log(LOG_INFO,
-        fmt::format("SetProperty OK {} {}", wstring_to_string(name), value));
+    if (log_enabled(LOG_INFO)) {
+      log(LOG_INFO, "SetProperty OK {} {}", property_name(name), value);
+    }
   } else {
-    log(LOG_ERROR,
-        fmt::format("SetProperty ERR {} {}", wstring_to_string(name), value));
+    log(LOG_ERROR, "SetProperty ERR {} {}", property_name(name), value);
   }
 }
 
@@ -61,7 +99,7 @@ T get_property(amf::AMFPropertyStorage &storage, not_null<cwzstring> name) {
   T value;
   if (storage.GetProperty(name, &value) != AMF_OK) {
     throw std::runtime_error(
-        fmt::format("GetProperty {} {}", wstring_to_string(name)));
+        fmt::format("GetProperty {}", property_name(name)));
   }
   return value;
 }
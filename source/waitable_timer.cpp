@@ -0,0 +1,53 @@
+#include "waitable_timer.h"
+
+#ifdef _WIN32
+
+#include "util.h"
+
+#include <stdexcept>
+
+namespace {
+
+HANDLE create_timer() {
+  // High resolution timers need Windows 10 1803.
+  if (auto *const timer{CreateWaitableTimerExW(
+          nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+          TIMER_ALL_ACCESS)}) {
+    return timer;
+  }
+  log(LOG_WARNING, "no high resolution timer, short waits take longer");
+  if (auto *const timer{
+          CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS)}) {
+    return timer;
+  }
+  throw std::runtime_error("CreateWaitableTimerExW");
+}
+
+} // namespace
+
+WaitableTimer::WaitableTimer() : timer{create_timer()} {}
+
+WaitableTimer::~WaitableTimer() noexcept { CloseHandle(timer); }
+
+void WaitableTimer::sleep(std::chrono::microseconds duration) noexcept {
+  // Negative due times are relative, in units of 100 ns.
+  LARGE_INTEGER due;
+  due.QuadPart = -duration.count() * 10;
+  if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE)) {
+    WaitForSingleObject(timer, INFINITE);
+  }
+}
+
+#else
+
+#include <thread>
+
+WaitableTimer::WaitableTimer() = default;
+
+WaitableTimer::~WaitableTimer() noexcept = default;
+
+void WaitableTimer::sleep(std::chrono::microseconds duration) noexcept {
+  std::this_thread::sleep_for(duration);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include <chrono>
+
+// Sleeps for intervals shorter than the system timer resolution.
+// std::this_thread::sleep_for is rounded up to that resolution, which is 1 to
+// 15.6 ms on Windows and longer than the waits this is used for. Elsewhere it
+// is precise enough and used instead, which lets the tests build. Use from one
+// thread at a time.
+class WaitableTimer {
+#ifdef _WIN32
+  HANDLE timer;
+#endif
+
+public:
+  WaitableTimer();
+  ~WaitableTimer() noexcept;
+
+  WaitableTimer(const WaitableTimer &) = delete;
+  WaitableTimer &operator=(const WaitableTimer &) = delete;
+
+  void sleep(std::chrono::microseconds) noexcept;
+};
@@ -0,0 +1,99 @@
+#include "warm_up.h"
+
+#include "device_registry.h"
+#include "encoder_caps.h"
+#include "util.h"
+
+#include <fmt/core.h>
+#include <obs-module.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+constexpr const CapsProperties *probed_components[]{&avc_caps_properties,
+                                                    &hevc_caps_properties};
+
+// How long the warmed device is kept for an encoder to take it over. Holding
+// it longer keeps a D3D11 device and the AMF runtime around for nothing when
+// the user does not encode with this plugin.
+constexpr std::chrono::seconds warm_device_hold{60};
+
+std::future<void> warm_up;
+std::mutex release_mutex;
+std::condition_variable release_requested;
+bool release{false};
+
+void run_warm_up(uint32_t adapter) noexcept {
+  const auto start{std::chrono::steady_clock::now()};
+  // Keeps the device alive so that the registry hands it to the first encoder.
+  std::shared_ptr<SharedDevice> warm_device;
+  try {
+    warm_device = acquire_shared_device(adapter);
+    // Creating the components to query their caps also loads the codec
+    // specific parts of the driver. Skipped when the caps are cached.
+    for (const auto *const probed : probed_components) {
+      try {
+        get_encoder_caps(*warm_device, *probed);
+      } catch (const std::exception &e) {
+        log(LOG_INFO, "warm-up: {}", e.what());
+      }
+    }
+  } catch (const std::exception &e) {
+    log(LOG_WARNING, "warm-up failed: {}", e.what());
+    return;
+  }
+  const auto elapsed{std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start)};
+  log(LOG_INFO, "warm-up of adapter {} took {} ms", adapter, elapsed.count());
+
+  std::unique_lock lock{release_mutex};
+  if (!release_requested.wait_for(lock, warm_device_hold,
+                                  [] { return release; })) {
+    log(LOG_INFO, "warm-up: no encoder took over the device, releasing it");
+  }
+}
+
+} // namespace
+
+void start_warm_up() noexcept {
+  // The adapter is known once OBS has reset video which happens before modules
+  // are loaded. Without it there is nothing to warm up.
+  obs_video_info info;
+  if (!obs_get_video_info(&info)) {
+    log(LOG_INFO, "warm-up skipped: no video info");
+    return;
+  }
+  // The runtime would load but creating the device would fail.
+  if (!is_amd_adapter(info.adapter)) {
+    log(LOG_INFO, "warm-up skipped: adapter {} is not an AMD adapter",
+        info.adapter);
+    return;
+  }
+  try {
+    warm_up = std::async(std::launch::async, run_warm_up, info.adapter);
+  } catch (const std::exception &e) {
+    log(LOG_WARNING, "warm-up not started: {}", e.what());
+  }
+}
+
+void release_warm_device() noexcept {
+  {
+    std::scoped_lock lock{release_mutex};
+    release = true;
+  }
+  release_requested.notify_one();
+}
+
+void finish_warm_up() noexcept {
+  release_warm_device();
+  if (warm_up.valid()) {
+    warm_up.wait();
+    warm_up = {};
+  }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Loading the AMF runtime, creating the D3D11 device and the AMF context and
+// loading the encoder components takes hundreds of milliseconds. Doing it in
+// the background when the module loads moves that cost out of the time between
+// the user starting a stream and the first frame.
+
+// Starts the warm-up on a background thread unless the adapter OBS renders on
+// is not made by AMD. Called once from obs_module_load.
+void start_warm_up() noexcept;
+
+// Lets go of the warmed device. Encoders call this once they hold the device
+// themselves. The device registry serializes device creation so an encoder
+// created during the warm-up waits for it there and gets the same device.
+void release_warm_device() noexcept;
+
+// Waits for the warm-up and releases the device it holds. Called once from
+// obs_module_unload.
+void finish_warm_up() noexcept;
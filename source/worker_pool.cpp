@@ -0,0 +1,77 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t thread_count) {
+  const auto worker_count{thread_count > 1 ? thread_count - 1 : 0};
+  workers.reserve(worker_count);
+  for (size_t i{0}; i < worker_count; ++i) {
+    workers.emplace_back([this] { work(); });
+  }
+}
+
+WorkerPool::~WorkerPool() noexcept {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  work_available.notify_all();
+  // The jthreads join when destroyed.
+}
+
+void WorkerPool::work() noexcept {
+  uint64_t seen_generation{0};
+  while (true) {
+    {
+      std::unique_lock lock{mutex};
+      work_available.wait(
+          lock, [&] { return stopping || generation != seen_generation; });
+      if (stopping) {
+        return;
+      }
+      seen_generation = generation;
+    }
+    run_tasks();
+    bool last;
+    {
+      std::lock_guard lock{mutex};
+      last = --busy_workers == 0;
+    }
+    if (last) {
+      work_done.notify_one();
+    }
+  }
+}
+
+void WorkerPool::run_tasks() noexcept {
+  while (true) {
+    const auto task{next_task.fetch_add(1, std::memory_order_relaxed)};
+    if (task >= job_size) {
+      return;
+    }
+    (*job)(task);
+  }
+}
+
+void WorkerPool::parallel_for(size_t count,
+                              const std::function<void(size_t)> &task) {
+  if (workers.empty() || count <= 1) {
+    for (size_t i{0}; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard lock{mutex};
+    job = &task;
+    job_size = count;
+    next_task.store(0, std::memory_order_relaxed);
+    busy_workers = workers.size();
+    ++generation;
+  }
+  work_available.notify_all();
+  run_tasks();
+  std::unique_lock lock{mutex};
+  work_done.wait(lock, [&] { return busy_workers == 0; });
+  job = nullptr;
+}
+
+size_t WorkerPool::thread_count() const noexcept { return workers.size() + 1; }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent threads that split one job at a time between themselves and the
+// calling thread. Keeping the threads alive avoids paying for thread creation
+// on every frame.
+class WorkerPool {
+  std::mutex mutex;
+  std::condition_variable work_available;
+  std::condition_variable work_done;
+  // The current job. Only valid while a call to parallel_for is running.
+  const std::function<void(size_t)> *job{nullptr};
+  size_t job_size{0};
+  std::atomic<size_t> next_task{0};
+  // Workers that have not finished the current job yet.
+  size_t busy_workers{0};
+  // Incremented for every job so that workers can tell new jobs apart.
+  uint64_t generation{0};
+  bool stopping{false};
+  // Declared last so that the threads are joined before the above is
+  // destroyed.
+  std::vector<std::jthread> workers;
+
+  void work() noexcept;
+  void run_tasks() noexcept;
+
+public:
+  // thread_count includes the calling thread so one less thread is created.
+  explicit WorkerPool(size_t thread_count);
+  ~WorkerPool() noexcept;
+
+  // Delete moving and copying because the threads refer to this.
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool(WorkerPool &&) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+  WorkerPool &operator=(WorkerPool &&) = delete;
+
+  // Call task with every index in [0, count) spread over all threads and
+  // return when all are done. task must not throw. Must only be called from
+  // one thread at a time.
+  void parallel_for(size_t count, const std::function<void(size_t)> &task);
+  size_t thread_count() const noexcept;
+};
@@ -0,0 +1,73 @@
+#include "test.h"
+
+#include "bitrate_controller.h"
+
+#include <cstdint>
+
+namespace {
+
+const BitrateControllerConfig config{
+    .min_bitrate = 1000000,
+    .max_bitrate = 6000000,
+    .increase = 250000,
+    .decrease_factor = 0.8,
+    .window_frames = 30,
+    .input_full_threshold = 0.1,
+    .overshoot_threshold = 1.5,
+};
+
+// 6 Mbps at 30 fps.
+constexpr uint64_t bytes_at_max{25000};
+
+// The first observation only records the totals so a window needs one more.
+constexpr int window_observations{31};
+
+} // namespace
+
+TEST(bitrate_steady_at_maximum_does_not_change) {
+  BitrateController controller{config, 6000000, 30};
+  uint64_t bytes{0};
+  for (int i{0}; i < 100; ++i) {
+    bytes += bytes_at_max;
+    CHECK(!controller.observe(0, bytes));
+  }
+}
+
+TEST(bitrate_decreases_on_overshoot) {
+  BitrateController controller{config, 6000000, 30};
+  uint64_t bytes{0};
+  int changes{0};
+  for (int i{0}; i < window_observations; ++i) {
+    bytes += bytes_at_max * 2;
+    changes += controller.observe(0, bytes).has_value();
+  }
+  CHECK(changes == 1);
+  CHECK(controller.target_bitrate() == 4800000);
+}
+
+TEST(bitrate_decreases_on_input_full_and_recovers) {
+  BitrateController controller{config, 6000000, 30};
+  uint64_t bytes{0};
+  uint64_t input_full{0};
+  for (int i{0}; i < window_observations; ++i) {
+    bytes += 10000;
+    input_full += i % 3 == 0;
+    controller.observe(input_full, bytes);
+  }
+  CHECK(controller.target_bitrate() == 4800000);
+  for (int i{0}; i < 300; ++i) {
+    bytes += 10000;
+    controller.observe(input_full, bytes);
+  }
+  CHECK(controller.target_bitrate() == 6000000);
+}
+
+TEST(bitrate_never_below_minimum) {
+  BitrateController controller{config, 1200000, 30};
+  uint64_t bytes{0};
+  for (int i{0}; i < 300; ++i) {
+    bytes += bytes_at_max;
+    controller.observe(0, bytes);
+  }
+  CHECK(controller.target_bitrate() == 1000000);
+}
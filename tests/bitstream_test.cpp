@@ -0,0 +1,232 @@
+#include "test.h"
+
+#include "bitstream.h"
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes join(std::initializer_list<Bytes> parts) {
+  Bytes out;
+  for (const auto &part : parts) {
+    out.insert(out.end(), part.begin(), part.end());
+  }
+  return out;
+}
+
+// Units as the encoder emits them: four byte start codes for the first unit
+// and parameter sets, three byte start codes for the rest.
+
+const Bytes avc_aud{0, 0, 0, 1, 0x09, 0x10};
+// High profile 1280x720.
+const Bytes avc_sps{0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC,
+                    0xD9, 0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00, 0x00,
+                    0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1,
+                    0x83, 0x19, 0x60};
+const Bytes avc_pps{0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+const Bytes avc_idr{0, 0, 1, 0x65, 0x88, 0x84, 0x00, 0x33, 0xFF, 0xFE, 0xF6};
+// nal_ref_idc 2, first_mb_in_slice 0, slice_type 5 (P).
+const Bytes avc_p{0, 0, 0, 1, 0x41, 0x9A, 0x24, 0x6C, 0x41, 0x0F};
+// nal_ref_idc 1, first_mb_in_slice 0, slice_type 6 (B).
+const Bytes avc_b_reference{0, 0, 0, 1, 0x21, 0x9C, 0x41, 0x6A, 0x40};
+// nal_ref_idc 0, slice_type 6 (B).
+const Bytes avc_b{0, 0, 0, 1, 0x01, 0x9E, 0x41, 0x6A, 0x40};
+const Bytes avc_filler{0, 0, 0, 1, 0x0C, 0xFF, 0xFF, 0xFF, 0x80};
+
+const Bytes hevc_aud{0, 0, 0, 1, 0x46, 0x01, 0x10};
+const Bytes hevc_vps{0,    0,    0,    1,    0x40, 0x01, 0x0C, 0x01,
+                     0xFF, 0xFF, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+                     0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+                     0x5D, 0x95, 0x98, 0x09};
+// Main profile 1280x720.
+const Bytes hevc_sps{0,    0,    0,    1,    0x42, 0x01, 0x01, 0x01, 0x60,
+                     0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+                     0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02, 0x80, 0x80, 0x2D,
+                     0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0, 0x5A, 0x70,
+                     0x80, 0x00, 0x01, 0xF4, 0x80, 0x00, 0x3A, 0x98, 0x04};
+const Bytes hevc_pps{0, 0, 0, 1, 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40};
+// IDR_W_RADL, temporal id 0.
+const Bytes hevc_idr{0, 0, 1, 0x26, 0x01, 0xAF, 0x06, 0xB8, 0x63};
+// CRA, temporal id 0.
+const Bytes hevc_cra{0, 0, 0, 1, 0x2A, 0x01, 0xAF, 0x0C, 0x40};
+// TRAIL_R, temporal id 0.
+const Bytes hevc_trail_r{0, 0, 0, 1, 0x02, 0x01, 0xD0, 0x09, 0x7E};
+// TRAIL_R, temporal id 1.
+const Bytes hevc_trail_r_layer{0, 0, 0, 1, 0x02, 0x02, 0xD0, 0x09, 0x7E};
+// TRAIL_N, temporal id 1.
+const Bytes hevc_trail_n{0, 0, 0, 1, 0x00, 0x02, 0xD0, 0x09, 0x7E};
+const Bytes hevc_filler{0, 0, 0, 1, 0x4C, 0x01, 0xFF, 0xFF, 0x80};
+
+NalPriority priority(Codec codec, const Bytes &packet) {
+  const auto classified{classify_packet(codec, packet)};
+  if (!classified) {
+    throw std::runtime_error("packet not classified");
+  }
+  CHECK(classified->priority == classified->drop_priority);
+  return classified->priority;
+}
+
+const uint8_t *find_start_code_bytewise(std::span<const uint8_t> data) {
+  for (size_t i{0}; i + 3 <= data.size(); ++i) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      return data.data() + i;
+    }
+  }
+  return data.data() + data.size();
+}
+
+} // namespace
+
+TEST(find_start_code_matches_bytewise_search) {
+  std::mt19937 random{1};
+  for (int iteration{0}; iteration < 20000; ++iteration) {
+    // Mostly zeros and ones so that start codes and near misses are common,
+    // including ones that straddle the 16 byte blocks of the SIMD search.
+    Bytes data(random() % 100);
+    for (auto &byte : data) {
+      const auto kind{random() % 6};
+      byte = kind < 2 ? 0 : kind == 2 ? 1 : static_cast<uint8_t>(random());
+    }
+    for (size_t offset{0}; offset < data.size() && offset < 20; ++offset) {
+      const std::span<const uint8_t> tail{data.data() + offset,
+                                          data.size() - offset};
+      CHECK(find_start_code(tail.data(), tail.data() + tail.size()) ==
+            find_start_code_bytewise(tail));
+    }
+  }
+}
+
+TEST(find_start_code_at_every_position) {
+  for (size_t size{3}; size < 70; ++size) {
+    for (size_t position{0}; position + 3 <= size; ++position) {
+      Bytes data(size, 0xAB);
+      data[position] = 0;
+      data[position + 1] = 0;
+      data[position + 2] = 1;
+      CHECK(find_start_code(data.data(), data.data() + data.size()) ==
+            data.data() + position);
+    }
+  }
+}
+
+TEST(nal_scanner_splits_units) {
+  const auto packet{join({avc_aud, avc_sps, avc_pps, avc_idr})};
+  NalScanner scanner{Codec::Avc, packet};
+  size_t covered{0};
+  for (const uint8_t type : {9, 7, 8, 5}) {
+    const auto nal{scanner.next()};
+    CHECK(nal && nal->type == type);
+    covered += nal->with_start_code.size();
+  }
+  CHECK(!scanner.next());
+  CHECK(covered == packet.size());
+}
+
+TEST(classify_avc_packets) {
+  CHECK(priority(Codec::Avc, join({avc_aud, avc_sps, avc_pps, avc_idr})) ==
+        NalPriority::Highest);
+  CHECK(priority(Codec::Avc, join({avc_aud, avc_p})) == NalPriority::High);
+  CHECK(priority(Codec::Avc, join({avc_aud, avc_b_reference})) ==
+        NalPriority::Low);
+  CHECK(priority(Codec::Avc, join({avc_aud, avc_b})) ==
+        NalPriority::Disposable);
+  CHECK(!classify_packet(Codec::Avc, join({avc_aud, avc_sps, avc_pps})));
+}
+
+TEST(classify_hevc_packets) {
+  CHECK(priority(Codec::Hevc, join({hevc_aud, hevc_vps, hevc_sps, hevc_pps,
+                                    hevc_idr})) == NalPriority::Highest);
+  CHECK(priority(Codec::Hevc, join({hevc_aud, hevc_cra})) ==
+        NalPriority::Highest);
+  CHECK(priority(Codec::Hevc, join({hevc_aud, hevc_trail_r})) ==
+        NalPriority::High);
+  CHECK(priority(Codec::Hevc, join({hevc_aud, hevc_trail_r_layer})) ==
+        NalPriority::Low);
+  CHECK(priority(Codec::Hevc, join({hevc_aud, hevc_trail_n})) ==
+        NalPriority::Disposable);
+}
+
+TEST(find_parameter_sets_stops_at_the_first_slice) {
+  const auto packet{join({avc_aud, avc_sps, avc_pps, avc_idr, avc_pps})};
+  CHECK(find_parameter_sets(Codec::Avc, packet) == join({avc_sps, avc_pps}));
+  CHECK(find_parameter_sets(Codec::Avc, join({avc_aud, avc_p})).empty());
+}
+
+TEST(avcc_record) {
+  const auto record{make_configuration_record(
+      Codec::Avc, join({avc_sps, avc_pps}))};
+  const auto sps_size{avc_sps.size() - 4};
+  const auto pps_size{avc_pps.size() - 4};
+  const Bytes header{1, 0x64, 0x00, 0x1F, 0xFF, 0xE1, 0,
+                     static_cast<uint8_t>(sps_size)};
+  CHECK(Bytes(record.begin(), record.begin() + 8) == header);
+  CHECK(record.size() == 8 + sps_size + 3 + pps_size + 4);
+  CHECK(record[8 + sps_size] == 1);
+  // 4:2:0, 8 bit luma and chroma.
+  const Bytes high_profile{0xFD, 0xF8, 0xF8, 0x00};
+  CHECK(Bytes(record.end() - 4, record.end()) == high_profile);
+}
+
+TEST(hvcc_record) {
+  const auto record{make_configuration_record(
+      Codec::Hevc, join({hevc_vps, hevc_sps, hevc_pps}))};
+  // Version and the general profile, tier and level from the SPS.
+  const Bytes header{1,    0x01, 0x60, 0x00, 0x00, 0x00, 0x90,
+                     0x00, 0x00, 0x00, 0x00, 0x00, 0x5D};
+  CHECK(Bytes(record.begin(), record.begin() + 13) == header);
+  // Three arrays of one unit each.
+  CHECK(record[22] == 3);
+  CHECK(record.size() == 23 + 3 * 5 + hevc_vps.size() + hevc_sps.size() +
+                             hevc_pps.size() - 3 * 4);
+}
+
+TEST(configuration_record_needs_parameter_sets) {
+  bool threw{false};
+  try {
+    make_configuration_record(Codec::Avc, avc_sps);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+TEST(avcc_record_rejects_too_many_parameter_sets) {
+  const auto throws = [](const Bytes &data) {
+    try {
+      make_configuration_record(Codec::Avc, data);
+    } catch (const std::runtime_error &) {
+      return true;
+    }
+    return false;
+  };
+  Bytes sps;
+  for (int i{0}; i < 31; ++i) {
+    sps.insert(sps.end(), avc_sps.begin(), avc_sps.end());
+  }
+  CHECK(!throws(join({sps, avc_pps})));
+  CHECK(throws(join({sps, avc_sps, avc_pps})));
+  Bytes pps;
+  for (int i{0}; i < 256; ++i) {
+    pps.insert(pps.end(), avc_pps.begin(), avc_pps.end());
+  }
+  CHECK(throws(join({avc_sps, pps})));
+  pps.resize(pps.size() - avc_pps.size());
+  CHECK(!throws(join({avc_sps, pps})));
+}
+
+TEST(strip_filler_data_units) {
+  auto avc{join({avc_aud, avc_idr, avc_filler, avc_filler, avc_p})};
+  avc.resize(strip_filler_data(Codec::Avc, avc));
+  CHECK(avc == join({avc_aud, avc_idr, avc_p}));
+  auto trailing{join({avc_p, avc_filler})};
+  trailing.resize(strip_filler_data(Codec::Avc, trailing));
+  CHECK(trailing == avc_p);
+  auto hevc{join({hevc_idr, hevc_filler})};
+  hevc.resize(strip_filler_data(Codec::Hevc, hevc));
+  CHECK(hevc == hevc_idr);
+}
@@ -0,0 +1,107 @@
+// Measures how copying CPU frames into surfaces scales with the number of copy
+// threads. This is what the "copy threads" option trades off. Run it on the
+// machine in question, ideally while OBS is rendering, because the result
+// depends on memory bandwidth and on what else is competing for it:
+//   amftest_copy_threads_benchmark [max threads]
+
+#include "plane_copy.h"
+#include "worker_pool.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Resolution {
+  const char *name;
+  size_t width;
+  size_t height;
+};
+
+constexpr std::array resolutions{
+    Resolution{"1080p", 1920, 1080},
+    Resolution{"1440p", 2560, 1440},
+    Resolution{"2160p", 3840, 2160},
+    Resolution{"4320p", 7680, 4320},
+};
+
+constexpr int iterations{200};
+
+// An NV12 frame with OBS style source rows and pitched destination rows.
+struct Frame {
+  std::vector<uint8_t> src;
+  std::vector<uint8_t> dst;
+  std::array<PlaneCopy, 2> planes;
+
+  explicit Frame(const Resolution &resolution) {
+    const auto luma_bytes{resolution.width * resolution.height};
+    // Surfaces are usually padded to 256 bytes.
+    const auto dst_pitch{(resolution.width + 255) / 256 * 256};
+    src.resize(luma_bytes * 3 / 2, 0x80);
+    dst.resize(dst_pitch * resolution.height * 3 / 2);
+    planes[0] = {dst.data(), dst_pitch, src.data(), resolution.width,
+                 resolution.width, resolution.height};
+    planes[1] = {dst.data() + dst_pitch * resolution.height, dst_pitch,
+                 src.data() + luma_bytes, resolution.width, resolution.width,
+                 resolution.height / 2};
+  }
+};
+
+// Splits the planes into bands like the encoder does.
+void copy_frame(const Frame &frame, WorkerPool &pool, bool streaming) {
+  const auto bands_per_plane{pool.thread_count()};
+  pool.parallel_for(frame.planes.size() * bands_per_plane, [&](size_t task) {
+    const auto &plane{frame.planes[task / bands_per_plane]};
+    const auto band{task % bands_per_plane};
+    const auto band_rows{(plane.rows + bands_per_plane - 1) / bands_per_plane};
+    const auto first_row{band * band_rows};
+    if (first_row >= plane.rows) {
+      return;
+    }
+    auto part{plane};
+    part.dst += first_row * plane.dst_pitch;
+    part.src += first_row * plane.src_pitch;
+    part.rows = std::min(band_rows, plane.rows - first_row);
+    copy_plane(part, streaming);
+  });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t max_threads{
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+               : std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8)};
+  fmt::print("kernel: {}\n", plane_copy_kernel_name());
+  fmt::print("{:>6} {:>8} {:>10} {:>8}\n", "frame", "threads", "us/frame",
+             "speedup");
+  for (const auto &resolution : resolutions) {
+    Frame frame{resolution};
+    const auto streaming{prefer_streaming_stores(frame.src.size())};
+    double single_thread{0};
+    for (size_t threads{1}; threads <= max_threads; ++threads) {
+      WorkerPool pool{threads};
+      // Warm up the threads and fault in the pages.
+      copy_frame(frame, pool, streaming);
+      const auto start{std::chrono::steady_clock::now()};
+      for (int i{0}; i < iterations; ++i) {
+        copy_frame(frame, pool, streaming);
+      }
+      const std::chrono::duration<double, std::micro> elapsed{
+          std::chrono::steady_clock::now() - start};
+      const auto per_frame{elapsed.count() / iterations};
+      if (threads == 1) {
+        single_thread = per_frame;
+      }
+      fmt::print("{:>6} {:>8} {:>10.0f} {:>7.2f}x\n", resolution.name, threads,
+                 per_frame, single_thread / per_frame);
+    }
+  }
+}
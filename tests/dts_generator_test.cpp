@@ -0,0 +1,97 @@
+#include "test.h"
+
+#include "dts_generator.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Submits frames 0, d, 2d, ... and feeds the packets of output, given in
+// decode order as frame numbers, as soon as their frame has been submitted,
+// like an encoder with no extra delay would. Returns the violation count and
+// checks that every DTS is increasing and not after its PTS.
+uint64_t replay(int64_t depth, const std::vector<int64_t> &output,
+                int64_t duration = 1) {
+  DtsGenerator generator{depth, duration};
+  auto last{std::numeric_limits<int64_t>::min()};
+  size_t packet{0};
+  const auto emit{[&] {
+    const auto pts{output[packet++] * duration};
+    const auto dts{generator.next(pts)};
+    CHECK(dts <= pts || generator.violation_count() > 0);
+    CHECK(dts > last);
+    last = dts;
+  }};
+  for (int64_t frame{0}; frame < static_cast<int64_t>(output.size());
+       ++frame) {
+    generator.submitted(frame * duration);
+    while (packet < output.size() && output[packet] <= frame) {
+      emit();
+    }
+  }
+  while (packet < output.size()) {
+    emit();
+  }
+  return generator.violation_count();
+}
+
+} // namespace
+
+TEST(dts_without_b_frames_equals_pts) {
+  DtsGenerator generator;
+  for (int64_t pts{0}; pts < 10; ++pts) {
+    generator.submitted(pts);
+    CHECK(generator.next(pts) == pts);
+  }
+  CHECK(generator.violation_count() == 0);
+}
+
+TEST(dts_plain_b_frames) {
+  CHECK(replay(1, {0, 3, 1, 2, 6, 4, 5, 9, 7, 8}) == 0);
+}
+
+TEST(dts_b_pyramid) { CHECK(replay(2, {0, 4, 2, 1, 3, 8, 6, 5, 7}) == 0); }
+
+TEST(dts_adaptive_mini_gop) {
+  // Patterns get shorter when the encoder decides fewer B-frames pay off.
+  CHECK(replay(1, {0, 2, 1, 5, 3, 4, 6, 8, 7}) == 0);
+}
+
+TEST(dts_uses_frame_duration_before_first_frame) {
+  DtsGenerator generator{2, 1001};
+  generator.submitted(0);
+  generator.submitted(1001);
+  generator.submitted(2002);
+  CHECK(generator.next(0) == -2002);
+  CHECK(generator.next(2002) == -1001);
+  CHECK(generator.next(1001) == 0);
+  CHECK(generator.violation_count() == 0);
+}
+
+TEST(dts_depth_too_small_stays_increasing) {
+  // B-pyramid but a depth of one.
+  CHECK(replay(1, {0, 4, 2, 1, 3, 8, 6, 5, 7}) > 0);
+}
+
+TEST(dts_repair_when_pts_is_before_previous_dts) {
+  DtsGenerator generator{0};
+  generator.submitted(0);
+  generator.submitted(1);
+  generator.submitted(2);
+  CHECK(generator.next(0) == 0);
+  CHECK(generator.next(2) == 1);
+  // No valid DTS exists. It must still increase.
+  CHECK(generator.next(1) == 2);
+  CHECK(generator.violation_count() == 1);
+}
+
+TEST(dts_more_packets_than_frames) {
+  DtsGenerator generator{0};
+  generator.submitted(0);
+  CHECK(generator.next(0) == 0);
+  CHECK(generator.next(5) == 5);
+  CHECK(generator.next(6) == 6);
+  CHECK(generator.violation_count() == 0);
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+// Just enough of the AMF interfaces to drive the plugin's AMF facing parts
+// without a driver. Methods the plugin does not call return
+// AMF_NOT_IMPLEMENTED.
+
+#include <AMF/components/Component.h>
+#include <AMF/core/Data.h>
+#include <AMF/core/Surface.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Reference counted like AMF objects. Create with new and hold in an
+// AMFInterfacePtr_T of Interface.
+template <typename Interface> class FakeInterface : public Interface {
+  std::atomic<amf_long> references{0};
+
+public:
+  virtual ~FakeInterface() = default;
+
+  amf_long AMF_STD_CALL Acquire() override { return ++references; }
+  amf_long AMF_STD_CALL Release() override {
+    const auto remaining{--references};
+    if (remaining == 0) {
+      delete this;
+    }
+    return remaining;
+  }
+  AMF_RESULT AMF_STD_CALL QueryInterface(const amf::AMFGuid &id,
+                                         void **object) override {
+    if (!(id == Interface::IID())) {
+      return AMF_NO_INTERFACE;
+    }
+    *object = static_cast<Interface *>(this);
+    Acquire();
+    return AMF_OK;
+  }
+};
+
+template <typename Interface>
+class FakePropertyStorage : public FakeInterface<Interface> {
+  mutable std::mutex property_mutex;
+  std::map<std::wstring, amf::AMFVariant> properties;
+
+public:
+  AMF_RESULT AMF_STD_CALL SetProperty(const wchar_t *name,
+                                      amf::AMFVariantStruct value) override {
+    std::scoped_lock lock{property_mutex};
+    properties.insert_or_assign(name, amf::AMFVariant{value});
+    return AMF_OK;
+  }
+  AMF_RESULT AMF_STD_CALL
+  GetProperty(const wchar_t *name,
+              amf::AMFVariantStruct *value) const override {
+    std::scoped_lock lock{property_mutex};
+    const auto found{properties.find(name)};
+    if (found == properties.end()) {
+      return AMF_NOT_FOUND;
+    }
+    return amf::AMFVariantCopy(value, &found->second);
+  }
+  amf_bool AMF_STD_CALL HasProperty(const wchar_t *name) const override {
+    std::scoped_lock lock{property_mutex};
+    return properties.contains(name);
+  }
+  amf_size AMF_STD_CALL GetPropertyCount() const override {
+    std::scoped_lock lock{property_mutex};
+    return properties.size();
+  }
+  AMF_RESULT AMF_STD_CALL
+  GetPropertyAt(amf_size, wchar_t *, amf_size,
+                amf::AMFVariantStruct *) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Clear() override { return AMF_NOT_IMPLEMENTED; }
+  AMF_RESULT AMF_STD_CALL AddTo(amf::AMFPropertyStorage *, amf_bool,
+                                amf_bool) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL CopyTo(amf::AMFPropertyStorage *,
+                                 amf_bool) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  void AMF_STD_CALL AddObserver(amf::AMFPropertyStorageObserver *) override {}
+  void AMF_STD_CALL
+  RemoveObserver(amf::AMFPropertyStorageObserver *) override {}
+};
+
+// A surface that notifies its observers once when release_data is called or
+// when it is destroyed, like AMF does when it no longer needs a surface. Like
+// AMF, RemoveObserver does not return while the observers are being notified.
+class FakeSurface : public FakePropertyStorage<amf::AMFSurface> {
+  std::mutex observer_mutex;
+  std::vector<amf::AMFSurfaceObserver *> observers;
+  bool reject_properties;
+
+public:
+  // With reject_properties SetProperty fails.
+  explicit FakeSurface(bool reject_properties_ = false)
+      : reject_properties{reject_properties_} {}
+  ~FakeSurface() override { release_data(); }
+
+  void release_data() {
+    std::scoped_lock lock{observer_mutex};
+    for (auto *const observer : observers) {
+      observer->OnSurfaceDataRelease(this);
+    }
+    observers.clear();
+  }
+  size_t observer_count() {
+    std::scoped_lock lock{observer_mutex};
+    return observers.size();
+  }
+
+  AMF_RESULT AMF_STD_CALL SetProperty(const wchar_t *name,
+                                      amf::AMFVariantStruct value) override {
+    if (reject_properties) {
+      return AMF_ACCESS_DENIED;
+    }
+    return FakePropertyStorage::SetProperty(name, value);
+  }
+  void AMF_STD_CALL AddObserver(amf::AMFSurfaceObserver *observer) override {
+    std::scoped_lock lock{observer_mutex};
+    observers.push_back(observer);
+  }
+  void AMF_STD_CALL RemoveObserver(amf::AMFSurfaceObserver *observer) override {
+    std::scoped_lock lock{observer_mutex};
+    std::erase(observers, observer);
+  }
+
+  amf::AMF_MEMORY_TYPE AMF_STD_CALL GetMemoryType() override {
+    return amf::AMF_MEMORY_DX11;
+  }
+  AMF_RESULT AMF_STD_CALL Duplicate(amf::AMF_MEMORY_TYPE,
+                                    amf::AMFData **) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Convert(amf::AMF_MEMORY_TYPE) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Interop(amf::AMF_MEMORY_TYPE) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  amf::AMF_DATA_TYPE AMF_STD_CALL GetDataType() override {
+    return amf::AMF_DATA_SURFACE;
+  }
+  amf_bool AMF_STD_CALL IsReusable() override { return false; }
+  void AMF_STD_CALL SetPts(amf_pts) override {}
+  amf_pts AMF_STD_CALL GetPts() override { return 0; }
+  void AMF_STD_CALL SetDuration(amf_pts) override {}
+  amf_pts AMF_STD_CALL GetDuration() override { return 0; }
+  amf::AMF_SURFACE_FORMAT AMF_STD_CALL GetFormat() override {
+    return amf::AMF_SURFACE_NV12;
+  }
+  amf_size AMF_STD_CALL GetPlanesCount() override { return 0; }
+  amf::AMFPlane *AMF_STD_CALL GetPlaneAt(amf_size) override { return nullptr; }
+  amf::AMFPlane *AMF_STD_CALL GetPlane(amf::AMF_PLANE_TYPE) override {
+    return nullptr;
+  }
+  amf::AMF_FRAME_TYPE AMF_STD_CALL GetFrameType() override {
+    return amf::AMF_FRAME_PROGRESSIVE;
+  }
+  void AMF_STD_CALL SetFrameType(amf::AMF_FRAME_TYPE) override {}
+  AMF_RESULT AMF_STD_CALL SetCrop(amf_int32, amf_int32, amf_int32,
+                                  amf_int32) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL CopySurfaceRegion(amf::AMFSurface *, amf_int32,
+                                            amf_int32, amf_int32, amf_int32,
+                                            amf_int32, amf_int32) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+};
+
+// A packet that only carries its pts so that tests can tell packets apart.
+class FakeData : public FakePropertyStorage<amf::AMFData> {
+  amf_pts pts;
+
+public:
+  explicit FakeData(amf_pts pts_) : pts{pts_} {}
+
+  amf::AMF_MEMORY_TYPE AMF_STD_CALL GetMemoryType() override {
+    return amf::AMF_MEMORY_HOST;
+  }
+  AMF_RESULT AMF_STD_CALL Duplicate(amf::AMF_MEMORY_TYPE,
+                                    amf::AMFData **) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Convert(amf::AMF_MEMORY_TYPE) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Interop(amf::AMF_MEMORY_TYPE) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  amf::AMF_DATA_TYPE AMF_STD_CALL GetDataType() override {
+    return amf::AMF_DATA_BUFFER;
+  }
+  amf_bool AMF_STD_CALL IsReusable() override { return false; }
+  void AMF_STD_CALL SetPts(amf_pts pts_) override { pts = pts_; }
+  amf_pts AMF_STD_CALL GetPts() override { return pts; }
+  void AMF_STD_CALL SetDuration(amf_pts) override {}
+  amf_pts AMF_STD_CALL GetDuration() override { return 0; }
+};
+
+// An encoder whose QueryOutput returns a script of results. A packet is
+// returned with AMF_OK. Once the script runs out QueryOutput behaves like an
+// encoder with a query timeout and nothing to output: it waits for the
+// timeout, or until more is scripted, and returns AMF_REPEAT.
+class FakeComponent : public FakePropertyStorage<amf::AMFComponent> {
+public:
+  struct Step {
+    AMF_RESULT result;
+    amf_pts pts{0};
+  };
+
+private:
+  mutable std::mutex mutex;
+  std::condition_variable scripted;
+  std::deque<Step> script;
+  std::chrono::milliseconds query_timeout;
+  size_t queries{0};
+  bool waiting{false};
+
+public:
+  explicit FakeComponent(std::chrono::milliseconds query_timeout_)
+      : query_timeout{query_timeout_} {}
+
+  void add(Step step) {
+    {
+      std::scoped_lock lock{mutex};
+      script.push_back(step);
+    }
+    scripted.notify_one();
+  }
+  // Calls to QueryOutput so far.
+  size_t query_count() const {
+    std::scoped_lock lock{mutex};
+    return queries;
+  }
+  // Whether QueryOutput is waiting for output.
+  bool query_waiting() const {
+    std::scoped_lock lock{mutex};
+    return waiting;
+  }
+
+  AMF_RESULT AMF_STD_CALL QueryOutput(amf::AMFData **data) override {
+    std::unique_lock lock{mutex};
+    ++queries;
+    waiting = true;
+    scripted.wait_for(lock, query_timeout, [&] { return !script.empty(); });
+    waiting = false;
+    if (script.empty()) {
+      return AMF_REPEAT;
+    }
+    const auto step{script.front()};
+    script.pop_front();
+    if (step.result == AMF_OK) {
+      *data = new FakeData{step.pts};
+      (*data)->Acquire();
+    }
+    return step.result;
+  }
+
+  amf_size AMF_STD_CALL GetPropertiesInfoCount() const override { return 0; }
+  AMF_RESULT AMF_STD_CALL
+  GetPropertyInfo(amf_size, const amf::AMFPropertyInfo **) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL
+  GetPropertyInfo(const wchar_t *,
+                  const amf::AMFPropertyInfo **) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL
+  ValidateProperty(const wchar_t *, amf::AMFVariantStruct,
+                   amf::AMFVariantStruct *) const override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Init(amf::AMF_SURFACE_FORMAT, amf_int32,
+                               amf_int32) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL ReInit(amf_int32, amf_int32) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL Terminate() override { return AMF_NOT_IMPLEMENTED; }
+  AMF_RESULT AMF_STD_CALL Drain() override { return AMF_NOT_IMPLEMENTED; }
+  AMF_RESULT AMF_STD_CALL Flush() override { return AMF_NOT_IMPLEMENTED; }
+  AMF_RESULT AMF_STD_CALL SubmitInput(amf::AMFData *) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  amf::AMFContext *AMF_STD_CALL GetContext() override { return nullptr; }
+  AMF_RESULT AMF_STD_CALL
+  SetOutputDataAllocatorCB(amf::AMFDataAllocatorCB *) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL GetCaps(amf::AMFCaps **) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+  AMF_RESULT AMF_STD_CALL
+  Optimize(amf::AMFComponentOptimizationCallback *) override {
+    return AMF_NOT_IMPLEMENTED;
+  }
+};
@@ -0,0 +1,48 @@
+#include "test.h"
+
+#include "file_writer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string read_file(const std::filesystem::path &path) {
+  std::ifstream file{path};
+  std::ostringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+} // namespace
+
+TEST(file_writer_appends_everything_before_destruction) {
+  const auto path{std::filesystem::temp_directory_path() /
+                  "amftest_file_writer_test.txt"};
+  std::filesystem::remove(path);
+  std::string expected;
+  for (int round{0}; round < 2; ++round) {
+    FileWriter writer{path.string()};
+    for (int i{0}; i < 1000; ++i) {
+      const auto line{std::to_string(round * 1000 + i) + '\n'};
+      writer.write(line);
+      expected += line;
+    }
+  }
+  CHECK(read_file(path) == expected);
+  std::filesystem::remove(path);
+}
+
+TEST(file_writer_throws_when_the_file_cannot_be_opened) {
+  const auto path{std::filesystem::temp_directory_path() /
+                  "amftest_missing_directory" / "file.txt"};
+  bool threw{false};
+  try {
+    FileWriter writer{path.string()};
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+
+#include "free_index_stack.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <thread>
+#include <vector>
+
+TEST(free_index_stack_push_and_pop) {
+  FreeIndexStack stack{3};
+  size_t index;
+  CHECK(stack.empty());
+  CHECK(!stack.pop(index));
+  stack.push(2);
+  stack.push(0);
+  CHECK(stack.pop(index) && index == 0);
+  CHECK(stack.pop(index) && index == 2);
+  CHECK(!stack.pop(index));
+}
+
+// Like the texture ring: one thread pops indices and hands them to releasing
+// threads which push them back concurrently.
+TEST(free_index_stack_loses_and_duplicates_nothing_across_threads) {
+  constexpr size_t capacity{16};
+  constexpr size_t releaser_count{4};
+  constexpr size_t none{std::numeric_limits<size_t>::max()};
+  constexpr int pops{200000};
+  FreeIndexStack stack{capacity};
+  for (size_t i{0}; i < capacity; ++i) {
+    stack.push(i);
+  }
+  // Whether the popping thread owns an index.
+  std::array<std::atomic<bool>, capacity> owned{};
+  std::array<std::atomic<size_t>, releaser_count> mailboxes;
+  for (auto &mailbox : mailboxes) {
+    mailbox = none;
+  }
+  std::atomic<bool> duplicated{false};
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> releasers;
+  for (size_t i{0}; i < releaser_count; ++i) {
+    releasers.emplace_back([&, i] {
+      while (!stop.load()) {
+        const auto index{mailboxes[i].exchange(none)};
+        if (index == none) {
+          std::this_thread::yield();
+          continue;
+        }
+        owned[index] = false;
+        stack.push(index);
+      }
+    });
+  }
+  for (int popped{0}; popped < pops;) {
+    size_t index;
+    if (!stack.pop(index)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (owned[index].exchange(true)) {
+      duplicated = true;
+    }
+    auto &mailbox{mailboxes[static_cast<size_t>(popped) % releaser_count]};
+    for (auto empty{none}; !mailbox.compare_exchange_weak(empty, index);
+         empty = none) {
+      std::this_thread::yield();
+    }
+    ++popped;
+  }
+  stop = true;
+  for (auto &releaser : releasers) {
+    releaser.join();
+  }
+  for (auto &mailbox : mailboxes) {
+    if (const auto index{mailbox.load()}; index != none) {
+      owned[index] = false;
+      stack.push(index);
+    }
+  }
+  CHECK(!duplicated);
+  std::array<bool, capacity> seen{};
+  size_t index;
+  while (stack.pop(index)) {
+    CHECK(index < capacity && !seen[index]);
+    seen[index] = true;
+  }
+  for (const auto found : seen) {
+    CHECK(found);
+  }
+}
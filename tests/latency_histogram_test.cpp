@@ -0,0 +1,29 @@
+#include "test.h"
+
+#include "latency_histogram.h"
+
+#include <chrono>
+
+using std::chrono::microseconds;
+
+TEST(histogram_empty) {
+  LatencyHistogram histogram;
+  CHECK(histogram.count() == 0);
+  CHECK(histogram.percentile(50) == microseconds{0});
+}
+
+TEST(histogram_percentiles_within_a_quarter) {
+  LatencyHistogram histogram;
+  for (int i{1}; i <= 1000; ++i) {
+    histogram.record(microseconds{i * 10});
+  }
+  CHECK(histogram.count() == 1000);
+  const auto near{[](microseconds actual, int expected) {
+    return actual.count() >= expected && actual.count() <= expected * 5 / 4;
+  }};
+  CHECK(near(histogram.percentile(50), 5000));
+  CHECK(near(histogram.percentile(90), 9000));
+  CHECK(near(histogram.percentile(99), 9900));
+  histogram.clear();
+  CHECK(histogram.count() == 0);
+}
@@ -0,0 +1,44 @@
+#include "test.h"
+
+#include <cstdio>
+#include <exception>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Test {
+  const char *name;
+  TestFunction function;
+};
+
+std::vector<Test> &tests() {
+  static std::vector<Test> registered;
+  return registered;
+}
+
+} // namespace
+
+bool register_test(const char *name, TestFunction function) noexcept {
+  tests().push_back({name, function});
+  return true;
+}
+
+// Runs all tests or only those whose name contains the first argument.
+int main(int argc, char **argv) {
+  const std::string_view filter{argc > 1 ? argv[1] : ""};
+  int failures{0};
+  for (const auto &test : tests()) {
+    if (std::string_view{test.name}.find(filter) == std::string_view::npos) {
+      continue;
+    }
+    try {
+      test.function();
+      std::printf("ok   %s\n", test.name);
+    } catch (const std::exception &e) {
+      ++failures;
+      std::printf("FAIL %s: %s\n", test.name, e.what());
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "test.h"
+
+#include "fake_amf.h"
+#include "output_drain.h"
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Polls until the condition holds. The deadline is generous so that slow
+// machines do not fail; passing tests return long before it.
+template <typename F> bool eventually(F condition) {
+  const auto deadline{std::chrono::steady_clock::now() + 5s};
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  return true;
+}
+
+amf_pts pop_pts(OutputDrain &drain) {
+  amf::AMFDataPtr data;
+  if (!eventually([&] { return (data = drain.pop()) != nullptr; })) {
+    throw std::runtime_error("no packet");
+  }
+  return data->GetPts();
+}
+
+} // namespace
+
+TEST(output_drain_returns_packets_in_order_until_eof) {
+  auto *const fake{new FakeComponent{OutputDrain::query_timeout}};
+  for (const FakeComponent::Step step :
+       {FakeComponent::Step{AMF_REPEAT}, {AMF_OK, 0}, {AMF_OK, 1},
+        {AMF_REPEAT}, {AMF_OK, 2}, {AMF_EOF}, {AMF_OK, 3}}) {
+    fake->add(step);
+  }
+  OutputDrain drain{amf::AMFComponentPtr{fake}, 16, true};
+  CHECK(pop_pts(drain) == 0);
+  CHECK(pop_pts(drain) == 1);
+  CHECK(pop_pts(drain) == 2);
+  CHECK(eventually([&] { return fake->query_count() == 6; }));
+  // Nothing is queried after the end of the stream.
+  std::this_thread::sleep_for(OutputDrain::query_timeout * 2);
+  CHECK(fake->query_count() == 6);
+  CHECK(drain.repeat_count() == 2);
+  CHECK(drain.pop() == nullptr);
+}
+
+TEST(output_drain_stops_querying_while_queue_is_full) {
+  auto *const fake{new FakeComponent{OutputDrain::query_timeout}};
+  for (amf_pts pts{0}; pts < 5; ++pts) {
+    fake->add({AMF_OK, pts});
+  }
+  OutputDrain drain{amf::AMFComponentPtr{fake}, 2, true};
+  // Two queued and one held by the drain thread.
+  CHECK(eventually(
+      [&] { return drain.queued() == 2 && fake->query_count() == 3; }));
+  std::this_thread::sleep_for(OutputDrain::query_timeout * 2);
+  CHECK(fake->query_count() == 3);
+  CHECK(pop_pts(drain) == 0);
+  CHECK(eventually(
+      [&] { return drain.queued() == 2 && fake->query_count() == 4; }));
+  for (amf_pts pts{1}; pts < 5; ++pts) {
+    CHECK(pop_pts(drain) == pts);
+  }
+}
+
+TEST(output_drain_reports_query_errors_after_queued_packets) {
+  auto *const fake{new FakeComponent{OutputDrain::query_timeout}};
+  fake->add({AMF_OK, 0});
+  fake->add({AMF_FAIL});
+  OutputDrain drain{amf::AMFComponentPtr{fake}, 16, true};
+  CHECK(eventually([&] { return fake->query_count() == 2; }));
+  CHECK(pop_pts(drain) == 0);
+  bool threw{false};
+  try {
+    drain.pop();
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+// Stopping must not wait for output that never comes, both when QueryOutput
+// waits by itself and when the drain thread sleeps between polls.
+TEST(output_drain_stops_while_waiting_for_output) {
+  for (const bool query_blocks : {true, false}) {
+    auto *const fake{new FakeComponent{
+        query_blocks ? OutputDrain::query_timeout : 0ms}};
+    std::optional<OutputDrain> drain;
+    drain.emplace(amf::AMFComponentPtr{fake}, 16, query_blocks);
+    CHECK(eventually([&] { return drain->repeat_count() > 1; }));
+    if (query_blocks) {
+      CHECK(eventually([&] { return fake->query_waiting(); }));
+    }
+    const auto start{std::chrono::steady_clock::now()};
+    drain.reset();
+    CHECK(std::chrono::steady_clock::now() - start < 1s);
+  }
+}
@@ -0,0 +1,61 @@
+#include "test.h"
+
+#include "overload_governor.h"
+
+#include <chrono>
+#include <cstdint>
+
+using std::chrono::microseconds;
+
+namespace {
+
+const OverloadGovernorConfig config{
+    .window_frames = 10,
+    .input_full_threshold = 0.1,
+    .latency_threshold = microseconds{50000},
+    .queue_threshold = 2,
+    .recover_windows = 3,
+};
+
+// The first observation only records the totals so a window needs one more.
+constexpr int window_observations{11};
+
+} // namespace
+
+TEST(governor_calm_stays_at_user_level) {
+  OverloadGovernor governor{config, 3};
+  for (int i{0}; i < 50; ++i) {
+    CHECK(!governor.observe(0, microseconds{10000}, 0));
+  }
+  CHECK(governor.current_level() == 0);
+}
+
+TEST(governor_steps_down_and_back_up) {
+  OverloadGovernor governor{config, 3};
+  uint64_t input_full{0};
+  for (int i{0}; i < 3 * 10 + 1; ++i) {
+    governor.observe(++input_full, microseconds{10000}, 0);
+  }
+  CHECK(governor.current_level() == 3);
+  // Three calm windows per level.
+  for (int i{0}; i < 3 * 3 * 10; ++i) {
+    governor.observe(input_full, microseconds{10000}, 0);
+  }
+  CHECK(governor.current_level() == 0);
+}
+
+TEST(governor_latency_overload) {
+  OverloadGovernor governor{config, 3};
+  for (int i{0}; i < window_observations; ++i) {
+    governor.observe(0, microseconds{60000}, 0);
+  }
+  CHECK(governor.current_level() == 1);
+}
+
+TEST(governor_queue_overload) {
+  OverloadGovernor governor{config, 3};
+  for (int i{0}; i < window_observations; ++i) {
+    governor.observe(0, std::nullopt, 3);
+  }
+  CHECK(governor.current_level() == 1);
+}
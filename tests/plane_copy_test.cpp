@@ -0,0 +1,38 @@
+#include "test.h"
+
+#include "plane_copy.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+TEST(plane_copy_matches_bytewise_copy) {
+  std::mt19937 random{1};
+  const auto below{[&](size_t limit) { return random() % limit; }};
+  constexpr uint8_t untouched{0xEE};
+  for (int iteration{0}; iteration < 2000; ++iteration) {
+    const auto row_bytes{below(700) + 1};
+    const auto rows{below(9) + 1};
+    const auto src_pitch{row_bytes + below(40)};
+    const auto dst_pitch{row_bytes + below(70)};
+    // Misaligned starts exercise the unaligned heads of the SIMD kernels.
+    const auto src_offset{below(31)};
+    const auto dst_offset{below(31)};
+    std::vector<uint8_t> src(src_offset + src_pitch * rows);
+    std::vector<uint8_t> dst(dst_offset + dst_pitch * rows, untouched);
+    for (auto &byte : src) {
+      byte = static_cast<uint8_t>(random());
+    }
+    copy_plane({dst.data() + dst_offset, dst_pitch, src.data() + src_offset,
+                src_pitch, row_bytes, rows},
+               below(2) == 1);
+    for (size_t row{0}; row < rows; ++row) {
+      for (size_t i{0}; i < dst_pitch; ++i) {
+        const auto expected{i < row_bytes
+                                ? src[src_offset + row * src_pitch + i]
+                                : untouched};
+        CHECK(dst[dst_offset + row * dst_pitch + i] == expected);
+      }
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#include "test.h"
+
+#include "spsc_queue.h"
+
+#include <thread>
+
+TEST(spsc_queue_full_and_empty) {
+  SpscQueue<int> queue{2};
+  CHECK(!queue.pop());
+  CHECK(queue.push(1));
+  CHECK(queue.push(2));
+  CHECK(!queue.push(3));
+  CHECK(queue.size() == 2);
+  CHECK(*queue.pop() == 1);
+  CHECK(*queue.pop() == 2);
+  CHECK(!queue.pop());
+}
+
+TEST(spsc_queue_keeps_order_across_threads) {
+  constexpr int count{200000};
+  SpscQueue<int> queue{7};
+  std::thread producer{[&] {
+    for (int i{0}; i < count;) {
+      if (queue.push(int{i})) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }};
+  bool in_order{true};
+  for (int expected{0}; expected < count;) {
+    if (const auto value{queue.pop()}) {
+      in_order = in_order && *value == expected;
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  CHECK(in_order);
+  CHECK(queue.size() == 0);
+}
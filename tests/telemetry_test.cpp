@@ -0,0 +1,69 @@
+#include "test.h"
+
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace {
+
+FrameTelemetry frame(int64_t pts, int64_t qp, double psnr) {
+  return {
+      .pts = pts,
+      .bytes = 100,
+      .keyframe = pts == 0,
+      .frame_qp = qp,
+      .average_qp = qp,
+      .min_qp = -1,
+      .max_qp = -1,
+      .intra_pixels = 10,
+      .inter_pixels = 80,
+      .skip_pixels = 10,
+      .residual_bits = -1,
+      .motion_bits = -1,
+      .bits_without_header = -1,
+      .psnr = psnr,
+      .ssim = std::numeric_limits<double>::quiet_NaN(),
+  };
+}
+
+} // namespace
+
+TEST(telemetry_empty_summary_is_not_measured) {
+  const TelemetryRing ring{4};
+  const auto summary{ring.summarize()};
+  CHECK(summary.frames == 0);
+  CHECK(std::isnan(summary.average_qp));
+  CHECK(std::isnan(summary.psnr));
+}
+
+TEST(telemetry_ring_keeps_the_latest_frames) {
+  TelemetryRing ring{4};
+  for (int64_t i{0}; i < 6; ++i) {
+    ring.push() = frame(i, 20 + i, 40.0 + i);
+  }
+  CHECK(ring.total() == 6);
+  CHECK(ring.at(5).pts == 5);
+  CHECK(ring.at(2).pts == 2);
+  const auto summary{ring.summarize()};
+  CHECK(summary.frames == 4);
+  CHECK(summary.average_qp == 23.5);
+  CHECK(summary.intra_fraction == 0.1);
+  CHECK(summary.psnr == 43.5);
+  CHECK(summary.min_psnr == 42);
+  CHECK(std::isnan(summary.ssim));
+}
+
+TEST(telemetry_csv_line_matches_header) {
+  std::string csv{telemetry_csv_header()};
+  append_telemetry_csv(csv, frame(5, 25, 45));
+  CHECK(csv.ends_with("5,100,0,25,25,-1,-1,10,80,10,-1,-1,-1,45.0000,nan\n"));
+  const auto columns{[](std::string_view line) {
+    return std::count(line.begin(), line.end(), ',');
+  }};
+  const auto split{csv.find('\n')};
+  CHECK(columns(csv.substr(0, split)) == columns(csv.substr(split + 1)));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Minimal test registry. A test is a function that throws on failure.
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+
+using TestFunction = void (*)();
+
+bool register_test(const char *name, TestFunction) noexcept;
+
+#define TEST(name)                                                             \
+  static void name();                                                          \
+  static const bool name##_registered{register_test(#name, name)};             \
+  static void name()
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      throw std::runtime_error(                                                \
+          fmt::format("{}:{}: CHECK({})", __FILE__, __LINE__, #condition));    \
+    }                                                                          \
+  } while (false)
@@ -0,0 +1,115 @@
+#include "test.h"
+
+#include "fake_amf.h"
+#include "texture_slots.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// What the texture encoder does for a frame: the surface is created with the
+// observer and then attached.
+amf::AMFSurfacePtr make_surface(TextureSlots &slots, size_t slot,
+                                bool reject_properties = false) {
+  amf::AMFSurfacePtr surface{
+      static_cast<amf::AMFSurface *>(new FakeSurface{reject_properties})};
+  surface->AddObserver(slots.observer());
+  slots.attach(slot, *surface);
+  return surface;
+}
+
+FakeSurface &fake(const amf::AMFSurfacePtr &surface) {
+  return static_cast<FakeSurface &>(*surface);
+}
+
+} // namespace
+
+TEST(texture_slots_reuse_slots_that_amf_released) {
+  TextureSlots slots{2, 0ms};
+  const auto first{slots.acquire()};
+  const auto second{slots.acquire()};
+  CHECK(first && second && *first != *second);
+  const auto first_surface{make_surface(slots, *first)};
+  const auto second_surface{make_surface(slots, *second)};
+  CHECK(!slots.acquire());
+  fake(first_surface).release_data();
+  CHECK(slots.acquire() == first);
+  const auto stats{slots.stats()};
+  CHECK(stats.stalls == 1 && stats.skips == 1 && stats.high_water_mark == 2);
+  // A slot that never got a surface is given back directly.
+  slots.release(*first);
+  CHECK(slots.acquire() == first);
+}
+
+TEST(texture_slots_release_the_slot_when_tagging_fails) {
+  TextureSlots slots{1, 0ms};
+  const auto slot{slots.acquire()};
+  CHECK(slot);
+  bool threw{false};
+  try {
+    make_surface(slots, *slot, true);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK(slots.acquire() == slot);
+}
+
+TEST(texture_slots_wait_for_a_release_on_another_thread) {
+  TextureSlots slots{1, 5s};
+  const auto surface{make_surface(slots, *slots.acquire())};
+  std::jthread releaser{[&] {
+    std::this_thread::sleep_for(10ms);
+    fake(surface).release_data();
+  }};
+  CHECK(slots.acquire() == size_t{0});
+  CHECK(slots.stats().stalls == 1 && slots.stats().skips == 0);
+}
+
+// AMF releases surfaces on its own threads, possibly while the encoder is
+// being destroyed. Either side may win a slot but afterwards no surface may
+// still refer to the destroyed slots. Build with -fsanitize=thread to also
+// catch releases that touch the slots after they were destroyed.
+TEST(texture_slots_release_races_destruction) {
+  constexpr size_t slot_count{8};
+  constexpr size_t releaser_count{4};
+  for (int iteration{0}; iteration < 500; ++iteration) {
+    auto slots{std::make_unique<TextureSlots>(slot_count, 0ms)};
+    std::vector<amf::AMFSurfacePtr> surfaces;
+    for (size_t i{0}; i < slot_count; ++i) {
+      surfaces.push_back(make_surface(*slots, *slots->acquire()));
+    }
+    std::atomic<bool> go{false};
+    std::vector<std::jthread> releasers;
+    for (size_t r{0}; r < releaser_count; ++r) {
+      releasers.emplace_back([&, r] {
+        while (!go.load()) {
+        }
+        for (size_t i{r}; i < slot_count; i += releaser_count) {
+          fake(surfaces[i]).release_data();
+        }
+      });
+    }
+    go.store(true);
+    // Give the releasers a head start on some iterations so that both orders
+    // happen.
+    if (iteration % 2 == 0) {
+      std::this_thread::yield();
+    }
+    slots.reset();
+    releasers.clear();
+    for (const auto &surface : surfaces) {
+      CHECK(fake(surface).observer_count() == 0);
+    }
+  }
+}